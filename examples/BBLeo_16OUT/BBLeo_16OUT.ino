@@ -11,9 +11,14 @@
 //   USB Serial1 (debugging)
 
 #include "cpNode.h"
+#include "cpPinMap.h"
 
 cpNode cmri;    // Processing logic for handling CMRINet packets
 
+// Onboard pins behind each OB byte, bit 0 first
+typedef cpPinMap::Pins< 4,  5,  6,  7,  8,  9, 10, 11> OB0;    // D4  - D11
+typedef cpPinMap::Pins<12, 13, A0, A1, A2, A3, A4, A5> OB1;    // D12 - A5
+
 const int  nodeID = 0;                            // 0...63 (nodeID + ord('A') => 'A'..chr(127))
 const long CMRINET_SPEED = 19200;                 // 9600, 19200 ...
 
@@ -51,23 +56,8 @@ void setup(void) {
     // *************************************************
     // *******   Setup  Onboard I/O           **********
     // *************************************************
-    pinMode( 4, OUTPUT);  // D4
-    pinMode( 5, OUTPUT);  // D5
-    pinMode( 6, OUTPUT);  // D6
-    pinMode( 7, OUTPUT);  // D7
-    pinMode( 8, OUTPUT);  // D8
-    pinMode( 9, OUTPUT);  // D9
-    pinMode(10, OUTPUT);  // D10
-    pinMode(11, OUTPUT);  // D11
-
-    pinMode(12, OUTPUT);  // D12
-    pinMode(13, OUTPUT);  // D13
-    pinMode(A0, OUTPUT);  // A0
-    pinMode(A1, OUTPUT);  // A1
-    pinMode(A2, OUTPUT);  // A2
-    pinMode(A3, OUTPUT);  // A3
-    pinMode(A4, OUTPUT);  // A4
-    pinMode(A5, OUTPUT);  // A5
+    OB0::setOutputs();    // D4 - D11
+    OB1::setOutputs();    // D12 - A5
 
 
     Serial.println(F("\nCMRI Node configuration: BBLEO_16OUT\n"));
@@ -106,23 +96,8 @@ void pack(byte *IB, int len) {
 //----------------------------------------------------------------------------
 
 void unpack(byte *OB, int len) {
-    digitalWrite(4,  (( OB[0] >> 0) &  0x01) );
-    digitalWrite(5,  (( OB[0] >> 1) &  0x01) );
-    digitalWrite(6,  (( OB[0] >> 2) &  0x01) );
-    digitalWrite(7,  (( OB[0] >> 3) &  0x01) );
-    digitalWrite(8,  (( OB[0] >> 4) &  0x01) );
-    digitalWrite(9,  (( OB[0] >> 5) &  0x01) );
-    digitalWrite(10, (( OB[0] >> 6) &  0x01) );
-    digitalWrite(11, (( OB[0] >> 7) &  0x01) );
-
-    digitalWrite(12, (( OB[1] >> 0) &  0x01) );
-    digitalWrite(13, (( OB[1] >> 1) &  0x01) );
-    digitalWrite(A0, (( OB[1] >> 2) &  0x01) );
-    digitalWrite(A1, (( OB[1] >> 3) &  0x01) );
-    digitalWrite(A2, (( OB[1] >> 4) &  0x01) );
-    digitalWrite(A3, (( OB[1] >> 5) &  0x01) );
-    digitalWrite(A4, (( OB[1] >> 6) &  0x01) );
-    digitalWrite(A5, (( OB[1] >> 7) &  0x01) );
+    OB0::write(OB[0]);      // PORTB, PORTC, PORTD and PORTE writes, not 8 digitalWrite()s
+    OB1::write(OB[1]);
 }
 
 void loop(void) {
@@ -14,15 +14,11 @@
 #include <Wire.h>  // for the I/O expander
 
 cpNode cmri;    // Processing logic for handling CMRINet packets
-IOX  iox;
+IOXBank bank;   // The expander ports, read by cmri itself after pack()
 
 const int  nodeID = 0;                            // 0...63 (nodeID + ord('A') => 'A'..chr(127))
 const long CMRINET_SPEED = 19200;                 // 9600, 19200 ...
 
-// the following need to match the code in setup(), pack() and unpack()...
-const int  InputBytes  = 2 + 16;                  // 2x onboard plus 4x IOX-32 (8x devices, 2 bytes each)
-const int  OutputBytes = 2 + 0;                   // 2x onboard
-
 void setup(void) {
     // *************************************************
     // *******          Setup CMRI            **********
@@ -33,37 +29,28 @@ void setup(void) {
 
     cmri.setCMRIPort(&Serial);
     cmri.setNodeAddress(nodeID);          // Set the node address
-    cmri.setNumInputBytes(InputBytes);    // reflected in pack(),   2x onboard plus IOX expander
-    cmri.setNumOutputBytes(OutputBytes);  // reflected in unpack(), 2x onboard plus IOX expander
 
     cmri.invertInputs(  true );           // invert all bits?
     cmri.invertOutputs( true );
 
+    cmri.setInputSamplePeriod(5000);      // read the 16 expander ports every 5ms, not while a poll waits
+
     // *************************************************
     // *******   Setup  Onboard I/O           **********
     // *************************************************
     // NONE
 
-    Wire.begin();
-    iox.init( 0x20, IOX::PORT_A, IOX::IN);     // IOX-32
-    iox.init( 0x20, IOX::PORT_B, IOX::IN);
-    iox.init( 0x21, IOX::PORT_A, IOX::IN);
-    iox.init( 0x21, IOX::PORT_B, IOX::IN);
-
-    iox.init( 0x22, IOX::PORT_A, IOX::IN);     // IOX-32
-    iox.init( 0x22, IOX::PORT_B, IOX::IN);
-    iox.init( 0x23, IOX::PORT_A, IOX::IN);
-    iox.init( 0x23, IOX::PORT_B, IOX::IN);
-
-    iox.init( 0x24, IOX::PORT_A, IOX::IN);     // IOX-32
-    iox.init( 0x24, IOX::PORT_B, IOX::IN);
-    iox.init( 0x25, IOX::PORT_A, IOX::IN);
-    iox.init( 0x25, IOX::PORT_B, IOX::IN);
-
-    iox.init( 0x26, IOX::PORT_A, IOX::IN);     // IOX-32
-    iox.init( 0x26, IOX::PORT_B, IOX::IN);
-    iox.init( 0x27, IOX::PORT_A, IOX::IN);
-    iox.init( 0x27, IOX::PORT_B, IOX::IN);
+    // *************************************************
+    // *******   Setup  IOX I/O               **********
+    // *************************************************
+    // 4x IOX-32 (8x devices, 2 bytes each) follow the 2 onboard bytes:
+    // IB[2] = 0x20 PORT_A, IB[3] = 0x20 PORT_B ... IB[17] = 0x27 PORT_B
+
+    IOX::begin();
+    for (int i2cAddress = 0x20; i2cAddress <= 0x27; i2cAddress++) {
+        bank.add16(i2cAddress, IOX::IN, IOX::IN);
+    }
+    bank.begin(cmri);                     // configures the devices and sets the number of input and output bytes
 }
 
 // ---------------------------------------------------------------------------
@@ -74,34 +61,13 @@ void setup(void) {
 //  external I/O expanders and puts the them into the correct IB array bytes
 //  for transmission back to the control host.
 //
-//  len bytes (as set by setNumInputBytes above) need to be read:
 //  Onboard I/O goes in the first two bytes, IB[0] and IB[1]
-//  The rest of the bytes are used by the optional IO expanders
+//  The rest of the bytes are read from the IO expanders by the IOXBank
 // ---------------------------------------------------------------------------
 
 void pack(byte *IB, int len) {
     IB[0] = 0;
     IB[1] = 0;
-
-    IB[2] = iox.read(0x20, IOX::PORT_A);
-    IB[3] = iox.read(0x20, IOX::PORT_B);
-    IB[4] = iox.read(0x21, IOX::PORT_A);
-    IB[5] = iox.read(0x21, IOX::PORT_B);
-
-    IB[6] = iox.read(0x22, IOX::PORT_A);
-    IB[7] = iox.read(0x22, IOX::PORT_B);
-    IB[8] = iox.read(0x23, IOX::PORT_A);
-    IB[9] = iox.read(0x23, IOX::PORT_B);
-
-    IB[10] = iox.read(0x24, IOX::PORT_A);
-    IB[11] = iox.read(0x24, IOX::PORT_B);
-    IB[12] = iox.read(0x25, IOX::PORT_A);
-    IB[13] = iox.read(0x25, IOX::PORT_B);
-
-    IB[14] = iox.read(0x26, IOX::PORT_A);
-    IB[15] = iox.read(0x26, IOX::PORT_B);
-    IB[16] = iox.read(0x27, IOX::PORT_A);
-    IB[17] = iox.read(0x27, IOX::PORT_B);
 }
 
 // ---------------------------------------------------------------------------
@@ -111,8 +77,8 @@ void pack(byte *IB, int len) {
 //  ouput buffer and write them to the correct output ports using either
 //  digitalWrite() or the IO expanders
 //
-//  len bytes (as set by setNumOutputBytes above) are available to be written
 //  Onboard I/O comes from the first two bytes, followed by IO expander bytes
+//  written by the IOXBank
 //----------------------------------------------------------------------------
 
 void unpack(byte *OB, int len) {
@@ -14,15 +14,11 @@
 #include <Wire.h>  // for the I/O expander
 
 cpNode cmri;    // Processing logic for handling CMRINet packets
-IOX  iox;
+IOXBank bank;   // The expander ports, written by cmri itself after unpack()
 
 const int  nodeID = 0;                            // 0...63 (nodeID + ord('A') => 'A'..chr(127))
 const long CMRINET_SPEED = 19200;                 // 9600, 19200 ...
 
-// the following need to match the code in setup(), pack() and unpack()...
-const int  InputBytes  = 2 + 0;                    // 2x onboard
-const int  OutputBytes = 2 + 16;                   // 2x onboard plus 4x IOX-32 (8x devices, 2 bytes each)
-
 void setup(void) {
     // *************************************************
     // *******          Setup CMRI            **********
@@ -33,57 +29,33 @@ void setup(void) {
 
     cmri.setCMRIPort(&Serial);
     cmri.setNodeAddress(nodeID);          // Set the node address
-    cmri.setNumInputBytes(InputBytes);    // reflected in pack(),   2x onboard plus IOX expander
-    cmri.setNumOutputBytes(OutputBytes);  // reflected in unpack(), 2x onboard plus IOX expander
 
     cmri.invertInputs(  true );           // invert all bits?
     cmri.invertOutputs( true );
 
+    cmri.setUnpackOnChange(true);         // don't call unpack() if the host resends the same outputs
+
     // *************************************************
     // *******   Setup  Onboard I/O           **********
     // *************************************************
     // NONE
 
-    Wire.begin();
-    iox.init( 0x20, IOX::PORT_A, IOX::OUT);     // IOX-32
-    iox.init( 0x20, IOX::PORT_B, IOX::OUT);
-    iox.init( 0x21, IOX::PORT_A, IOX::OUT);
-    iox.init( 0x21, IOX::PORT_B, IOX::OUT);
-
-    iox.init( 0x22, IOX::PORT_A, IOX::OUT);     // IOX-32
-    iox.init( 0x22, IOX::PORT_B, IOX::OUT);
-    iox.init( 0x23, IOX::PORT_A, IOX::OUT);
-    iox.init( 0x23, IOX::PORT_B, IOX::OUT);
-
-    iox.init( 0x24, IOX::PORT_A, IOX::OUT);     // IOX-32
-    iox.init( 0x24, IOX::PORT_B, IOX::OUT);
-    iox.init( 0x25, IOX::PORT_A, IOX::OUT);
-    iox.init( 0x25, IOX::PORT_B, IOX::OUT);
-
-    iox.init( 0x26, IOX::PORT_A, IOX::OUT);     // IOX-32
-    iox.init( 0x26, IOX::PORT_B, IOX::OUT);
-    iox.init( 0x27, IOX::PORT_A, IOX::OUT);
-    iox.init( 0x27, IOX::PORT_B, IOX::OUT);
-
-    iox.write(0x20, IOX::PORT_A, 0x00);  // if desired, set initial output state for each port
-    iox.write(0x20, IOX::PORT_B, 0x00);
-    iox.write(0x21, IOX::PORT_A, 0x00);
-    iox.write(0x21, IOX::PORT_B, 0x00);
-
-    iox.write(0x22, IOX::PORT_A, 0x00);
-    iox.write(0x22, IOX::PORT_B, 0x00);
-    iox.write(0x23, IOX::PORT_A, 0x00);
-    iox.write(0x23, IOX::PORT_B, 0x00);
-
-    iox.write(0x24, IOX::PORT_A, 0x00);
-    iox.write(0x24, IOX::PORT_B, 0x00);
-    iox.write(0x25, IOX::PORT_A, 0x00);
-    iox.write(0x25, IOX::PORT_B, 0x00);
-
-    iox.write(0x26, IOX::PORT_A, 0x00);
-    iox.write(0x26, IOX::PORT_B, 0x00);
-    iox.write(0x27, IOX::PORT_A, 0x00);
-    iox.write(0x27, IOX::PORT_B, 0x00);
+    // *************************************************
+    // *******   Setup  IOX I/O               **********
+    // *************************************************
+    // 4x IOX-32 (8x devices, 2 bytes each) follow the 2 onboard bytes:
+    // OB[2] = 0x20 PORT_A, OB[3] = 0x20 PORT_B ... OB[17] = 0x27 PORT_B
+
+    IOX::begin();
+    for (int i2cAddress = 0x20; i2cAddress <= 0x27; i2cAddress++) {
+        bank.add16(i2cAddress, IOX::OUT, IOX::OUT);
+    }
+    bank.begin(cmri);                     // configures the devices and sets the number of input and output bytes
+
+    const byte off[2] = { 0x00, 0x00 };   // if desired, set initial output state for each device
+    for (int i2cAddress = 0x20; i2cAddress <= 0x27; i2cAddress++) {
+        IOX::write16(i2cAddress, off);
+    }
 }
 
 // ---------------------------------------------------------------------------
@@ -110,35 +82,14 @@ void pack(byte *IB, int len) {
 //  ouput buffer and write them to the correct output ports using either
 //  digitalWrite() or the IO expanders
 //
-//  len bytes (as set by setNumOutputBytes above) are available to be written
-//  Onboard I/O comes from the first two bytes, followed by IO expander bytes
+//  Onboard I/O comes from the first two bytes, followed by IO expander bytes;
+//  the IOXBank writes the expander ports whose bytes changed
 //----------------------------------------------------------------------------
 
 void unpack(byte *OB, int len) {
     // onboard 16 bits (bytes 0 and 1) are inputs...
     // ... OB[0]
     // ... OB[1]
-
-    // IOX32 #1 segments 1 & 2
-    iox.write(0x20, IOX::PORT_A, OB[2]);
-    iox.write(0x20, IOX::PORT_B, OB[3]);
-    iox.write(0x21, IOX::PORT_A, OB[4]);
-    iox.write(0x21, IOX::PORT_B, OB[5]);
-    // IOX32 #2 segments 1 & 2
-    iox.write(0x22, IOX::PORT_A, OB[6]);
-    iox.write(0x22, IOX::PORT_B, OB[7]);
-    iox.write(0x23, IOX::PORT_A, OB[8]);
-    iox.write(0x23, IOX::PORT_B, OB[9]);
-    // IOX32 #3 segments 1 & 2
-    iox.write(0x24, IOX::PORT_A, OB[6]);
-    iox.write(0x24, IOX::PORT_B, OB[7]);
-    iox.write(0x25, IOX::PORT_A, OB[8]);
-    iox.write(0x25, IOX::PORT_B, OB[9]);
-    // IOX32 #4 segments 1 & 2
-    iox.write(0x26, IOX::PORT_A, OB[6]);
-    iox.write(0x26, IOX::PORT_B, OB[7]);
-    iox.write(0x27, IOX::PORT_A, OB[8]);
-    iox.write(0x27, IOX::PORT_B, OB[9]);
 }
 
 void loop(void) {
@@ -11,11 +11,16 @@
 
 
 #include "cpNode.h"
+#include "cpPinMap.h"
 #include <Wire.h>  // for the I/O expander
 
 cpNode cmri;    // Processing logic for handling CMRINet packets
 IOX  iox;
 
+// Onboard pins behind each IB byte, bit 0 first; active low (true)
+typedef cpPinMap::Pins< 2,  3,  4,  5,  6,  7,  8,  9, true> IB0;   // D2  - D9
+typedef cpPinMap::Pins<10, 11, 12, 13, A0, A1, A2, A3, true> IB1;   // D10 - A3
+
 const int  nodeID = 0;                            // 0...63 (nodeID + ord('A') => 'A'..chr(127))
 const long CMRINET_SPEED = 19200;                 // 9600, 19200 ...
 
@@ -42,23 +47,8 @@ void setup(void) {
     // *************************************************
     // *******   Setup  Onboard I/O           **********
     // *************************************************
-    pinMode( 2, INPUT_PULLUP);        // D2
-    pinMode( 3, INPUT_PULLUP);        // D3
-    pinMode( 4, INPUT_PULLUP);        // D4
-    pinMode( 5, INPUT_PULLUP);        // D5
-    pinMode( 6, INPUT_PULLUP);        // D6
-    pinMode( 7, INPUT_PULLUP);        // D7
-    pinMode( 8, INPUT_PULLUP);        // D8
-    pinMode( 9, INPUT_PULLUP);        // D9
-
-    pinMode(10, INPUT_PULLUP);        // D10
-    pinMode(11, INPUT_PULLUP);        // D11
-    pinMode(12, INPUT_PULLUP);        // D12
-    pinMode(13, INPUT_PULLUP);        // D13
-    pinMode(A0, INPUT_PULLUP);        // A0
-    pinMode(A1, INPUT_PULLUP);        // A1
-    pinMode(A2, INPUT_PULLUP);        // A2
-    pinMode(A3, INPUT_PULLUP);        // A3
+    IB0::setInputs();                 // D2 - D9,  INPUT_PULLUP
+    IB1::setInputs();                 // D10 - A3, INPUT_PULLUP
 
     Wire.begin();
     iox.init( 0x20, IOX::PORT_A, IOX::OUT);     // IOX-32
@@ -96,25 +86,8 @@ void setup(void) {
 // ---------------------------------------------------------------------------
 
 void pack(byte *IB, int len) {
-    IB[0] = 0;
-    IB[0] |= (!digitalRead( 2) << 0);
-    IB[0] |= (!digitalRead( 3) << 1);
-    IB[0] |= (!digitalRead( 4) << 2);
-    IB[0] |= (!digitalRead( 5) << 3);
-    IB[0] |= (!digitalRead( 6) << 4);
-    IB[0] |= (!digitalRead( 7) << 5);
-    IB[0] |= (!digitalRead( 8) << 6);
-    IB[0] |= (!digitalRead( 9) << 7);
-
-    IB[1] = 0;
-    IB[1] |= (!digitalRead(10) << 0);
-    IB[1] |= (!digitalRead(11) << 1);
-    IB[1] |= (!digitalRead(12) << 2);
-    IB[1] |= (!digitalRead(13) << 3);
-    IB[1] |= (!digitalRead(A0) << 4);
-    IB[1] |= (!digitalRead(A1) << 5);
-    IB[1] |= (!digitalRead(A2) << 6);
-    IB[1] |= (!digitalRead(A3) << 7);
+    IB[0] = IB0::read();        // one PIND and one PINB read
+    IB[1] = IB1::read();        // one PINB and one PINC read
 }
 
 // ---------------------------------------------------------------------------
@@ -0,0 +1,67 @@
+//==================================================================================
+//
+//  bench - Host benchmarks for the cpNode library
+//
+//      bench               run them all
+//      bench iox shift     run only the named groups
+//
+//==================================================================================
+
+#include "bench.h"
+
+// The library's default pack() and unpack(), for nodes without handlers
+extern "C" {
+    void pack(  byte *, int) { }
+    void unpack(byte *, int) { }
+}
+
+volatile byte bench::sink;
+
+std::vector<byte> bench::frame(byte node, char type, const byte *data, int len) {
+    std::vector<byte> f;
+
+    f.push_back(0xFF);          // SYN
+    f.push_back(0xFF);          // SYN
+    f.push_back(0x02);          // STX
+    f.push_back('A' + node);
+    f.push_back(type);
+    for (int i = 0; i < len; i++) {
+        if ((data[i] == 0x02) || (data[i] == 0x03) || (data[i] == 0x10)) {
+            f.push_back(0x10);  // DLE
+        }
+        f.push_back(data[i]);
+    }
+    f.push_back(0x03);          // ETX
+    return f;
+}
+
+void bench::section(const char *title) {
+    printf("\n%s\n", title);
+}
+
+void bench::report(const char *name, double value, const char *unit, const char *note) {
+    printf("  %-44s %12.1f %-10s %s\n", name, value, unit, note);
+}
+
+static const struct {
+    const char *name;
+    void (*fn)(void);
+} groups[] = {
+    { "protocol",   benchProtocol },
+    { "iox",        benchIOX },
+    { "inputs",     benchInputs },
+    { "shift",      benchShift },
+};
+
+int main(int argc, char **argv) {
+    for (unsigned g = 0; g < sizeof(groups) / sizeof(groups[0]); g++) {
+        bool run = (argc < 2);
+        for (int a = 1; a < argc; a++) {
+            run |= (strcmp(argv[a], groups[g].name) == 0);
+        }
+        if (run) {
+            groups[g].fn();
+        }
+    }
+    return 0;
+}
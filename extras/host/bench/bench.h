@@ -0,0 +1,59 @@
+#pragma once
+
+/*
+    ==================================================================================
+                  bench.h               Host benchmarks for the cpNode library
+    ==================================================================================
+
+    Two kinds of numbers come out of these:
+
+      - host ns: time on the machine running the benchmark.  Only useful to
+        compare one code path with another, or before and after a change;
+        an AVR is a couple of hundred times slower, and not evenly so.
+
+      - sim us: simulated time, which only moves for I2C transfers (see the
+        shim's Wire.h), so it is the time a node spends waiting on the bus.
+
+    Counts (I2C transactions, bytes) are exact.
+*/
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <MemStream.h>
+#include <cpNode.h>
+#include <chrono>
+#include <vector>
+
+namespace bench {
+    // SYN SYN STX <'A'+node> <type> <data, DLE escaped> ETX
+    std::vector<byte> frame(byte node, char type, const byte *data = NULL, int len = 0);
+
+    // Host nanoseconds per call of fn(), over enough calls to take a while
+    template<typename Fn>
+    double hostNs(Fn fn, unsigned long minCalls = 1000) {
+        typedef std::chrono::steady_clock clock;
+        unsigned long calls = 0;
+        clock::time_point start = clock::now();
+        clock::duration elapsed;
+
+        do {
+            for (unsigned long i = 0; i < minCalls; i++) {
+                fn();
+            }
+            calls += minCalls;
+            elapsed = clock::now() - start;
+        } while (elapsed < std::chrono::milliseconds(200));
+        return std::chrono::duration<double, std::nano>(elapsed).count() / calls;
+    }
+
+    void section(const char *title);
+    void report(const char *name, double value, const char *unit, const char *note = "");
+
+    extern volatile byte sink;      // results the compiler must not optimize away
+}
+
+// Benchmark groups
+void benchProtocol(void);
+void benchIOX(void);
+void benchInputs(void);
+void benchShift(void);
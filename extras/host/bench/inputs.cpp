@@ -0,0 +1,168 @@
+//==================================================================================
+//
+//  Input and output benchmarks: debouncing, and cpPinMap register access
+//  against digitalRead()/digitalWrite()
+//
+//==================================================================================
+
+#include "bench.h"
+#include <cpPinMap.h>
+
+using namespace bench;
+
+// ----------------------------------------------------------------------
+//  Debouncer cost per background sample of all IO_bufsize input bytes
+// ----------------------------------------------------------------------
+static unsigned long noise = 1;
+
+static void packNoisy(byte *IB, int len) {
+    for (int i = 0; i < len; i++) {
+        noise ^= noise << 13;
+        noise ^= noise >> 7;
+        noise ^= noise << 17;
+        IB[i] = (byte)noise;
+    }
+}
+
+static double sample(byte debounce) {
+    cpNode node;
+    MemStream port;
+
+    node.setCMRIPort(&port);
+    node.setNodeAddress(0);
+    node.setNumInputBytes(cpNode::IO_bufsize);
+    node.setPackHandler(packNoisy);
+    if (debounce) {
+        node.setDebounce(debounce, 1000);
+    } else {
+        node.setInputSamplePeriod(1000);
+    }
+    return hostNs([&]() {
+        cpShim::advance(1000);
+        node.proceess();
+    });
+}
+
+static void debounce(void) {
+    char note[64];
+    double plain = sample(0);
+    double db = sample(4);
+
+    section("Debouncing, 22 input bytes sampled in the background");
+    report("sample, no debounce", plain, "host ns");
+    report("sample, debounce over 4 samples", db, "host ns");
+    snprintf(note, sizeof(note), "%.2f host ns per input byte (8 inputs)",
+             (db - plain) / cpNode::IO_bufsize);
+    report("debounce cost per sample", db - plain, "host ns", note);
+}
+
+
+// ----------------------------------------------------------------------
+//  16 inputs and 16 outputs on a Pro Mini, the way the examples used to
+//  do it and with cpPinMap
+// ----------------------------------------------------------------------
+typedef cpPinMap::Pins< 2,  3,  4,  5,  6,  7,  8,  9> Byte0;
+typedef cpPinMap::Pins<10, 11, 12, 13, A0, A1, A2, A3> Byte1;
+
+static void readPins(byte *IB) {
+    IB[0]  = (digitalRead(2)  << 0);
+    IB[0] |= (digitalRead(3)  << 1);
+    IB[0] |= (digitalRead(4)  << 2);
+    IB[0] |= (digitalRead(5)  << 3);
+    IB[0] |= (digitalRead(6)  << 4);
+    IB[0] |= (digitalRead(7)  << 5);
+    IB[0] |= (digitalRead(8)  << 6);
+    IB[0] |= (digitalRead(9)  << 7);
+    IB[1]  = (digitalRead(10) << 0);
+    IB[1] |= (digitalRead(11) << 1);
+    IB[1] |= (digitalRead(12) << 2);
+    IB[1] |= (digitalRead(13) << 3);
+    IB[1] |= (digitalRead(A0) << 4);
+    IB[1] |= (digitalRead(A1) << 5);
+    IB[1] |= (digitalRead(A2) << 6);
+    IB[1] |= (digitalRead(A3) << 7);
+}
+
+static void writePins(const byte *OB) {
+    digitalWrite(2,  (OB[0] >> 0) & 0x01);
+    digitalWrite(3,  (OB[0] >> 1) & 0x01);
+    digitalWrite(4,  (OB[0] >> 2) & 0x01);
+    digitalWrite(5,  (OB[0] >> 3) & 0x01);
+    digitalWrite(6,  (OB[0] >> 4) & 0x01);
+    digitalWrite(7,  (OB[0] >> 5) & 0x01);
+    digitalWrite(8,  (OB[0] >> 6) & 0x01);
+    digitalWrite(9,  (OB[0] >> 7) & 0x01);
+    digitalWrite(10, (OB[1] >> 0) & 0x01);
+    digitalWrite(11, (OB[1] >> 1) & 0x01);
+    digitalWrite(12, (OB[1] >> 2) & 0x01);
+    digitalWrite(13, (OB[1] >> 3) & 0x01);
+    digitalWrite(A0, (OB[1] >> 4) & 0x01);
+    digitalWrite(A1, (OB[1] >> 5) & 0x01);
+    digitalWrite(A2, (OB[1] >> 6) & 0x01);
+    digitalWrite(A3, (OB[1] >> 7) & 0x01);
+}
+
+// The levels pins <first>..<first>+7 are driving, as a byte
+static byte levels(byte first) {
+    byte v = 0;
+    for (byte k = 0; k < 8; k++) {
+        v |= cpShim::getPin(first + k) << k;
+    }
+    return v;
+}
+
+static void pinMaps(void) {
+    byte IB[2], map[2];
+    byte OB[2] = { 0xA5, 0x3C };
+    bool same = true;
+    bool sameOut = true;
+    char note[64];
+    double slow, fast;
+
+    // Same answers both ways, for every level on every pin
+    for (int v = 0; v < 256; v++) {
+        for (byte k = 0; k < 8; k++) {
+            cpShim::setPin(2 + k,  (v >> k) & 1);
+            cpShim::setPin(10 + k, (~v >> k) & 1);
+        }
+        readPins(IB);
+        map[0] = Byte0::read();
+        map[1] = Byte1::read();
+        same &= (IB[0] == map[0]) && (IB[1] == map[1]);
+    }
+
+    // ... and the same levels on the output pins
+    for (int v = 0; v < 256; v++) {
+        OB[0] = v;
+        OB[1] = ~v;
+        Byte0::write(~OB[0]);
+        Byte1::write(~OB[1]);
+        writePins(OB);
+        map[0] = levels(2);
+        map[1] = levels(10);
+        Byte0::write(~OB[0]);
+        Byte1::write(~OB[1]);
+        Byte0::write(OB[0]);
+        Byte1::write(OB[1]);
+        sameOut &= (levels(2) == map[0]) && (levels(10) == map[1]) && (map[0] == OB[0]) && (map[1] == OB[1]);
+    }
+
+    section("16 inputs, 16 outputs on a Pro Mini");
+
+    slow = hostNs([&]() { readPins(IB); sink = IB[0] ^ IB[1]; });
+    fast = hostNs([&]() { sink = Byte0::read() ^ Byte1::read(); });
+    snprintf(note, sizeof(note), "%.1fx faster with cpPinMap%s", slow / fast, same ? "" : ", RESULTS DIFFER");
+    report("pack(), digitalRead() per bit", slow, "host ns");
+    report("pack(), cpPinMap", fast, "host ns", note);
+
+    slow = hostNs([&]() { OB[0]++; writePins(OB); });
+    fast = hostNs([&]() { OB[0]++; Byte0::write(OB[0]); Byte1::write(OB[1]); });
+    snprintf(note, sizeof(note), "%.1fx faster with cpPinMap%s", slow / fast, sameOut ? "" : ", RESULTS DIFFER");
+    report("unpack(), digitalWrite() per bit", slow, "host ns");
+    report("unpack(), cpPinMap", fast, "host ns", note);
+}
+
+void benchInputs(void) {
+    debounce();
+    pinMaps();
+}
@@ -0,0 +1,118 @@
+//==================================================================================
+//
+//  IOX benchmarks: I2C transactions and bus time per CMRI message
+//
+//  The node has 2 input bytes on the expander at 0x20 and 4 output bytes
+//  on 0x22 and 0x23, after the 2 onboard bytes, handled either by an
+//  IOXBank or the way the examples used to: one IOX::read() or
+//  IOX::write() per port in pack() and unpack().
+//
+//==================================================================================
+
+#include "bench.h"
+
+using namespace bench;
+
+static const int Messages = 200;
+
+static void packPorts(byte *IB, int len) {
+    if (len >= 4) {
+        IB[2] = IOX::read(0x20, IOX::PORT_A);
+        IB[3] = IOX::read(0x20, IOX::PORT_B);
+    }
+}
+
+static void unpackPorts(byte *OB, int len) {
+    if (len >= 6) {
+        IOX::write(0x22, IOX::PORT_A, OB[2]);
+        IOX::write(0x22, IOX::PORT_B, OB[3]);
+        IOX::write(0x23, IOX::PORT_A, OB[4]);
+        IOX::write(0x23, IOX::PORT_B, OB[5]);
+    }
+}
+
+// ----------------------------------------------------------------------
+//  Run <messages>, in turn, through the node until each one has been
+//  answered and any queued I2C work is done.  The last one goes through
+//  first, untimed, so the outputs start out as they would in a steady run.
+// ----------------------------------------------------------------------
+static void run(const char *name, cpNode &node, MemStream &port, IOXQueue *q,
+                const std::vector< std::vector<byte> > &messages) {
+    unsigned long longest = 0;
+    unsigned long start;
+    char note[80];
+
+    for (int i = -1; i < Messages; i++) {
+        if (i == 0) {
+            Wire.resetStats();
+            longest = 0;
+        }
+        port.clear();
+        port.feed(messages[(i + messages.size()) % messages.size()]);
+        do {
+            start = cpShim::now_us;
+            node.proceess();
+            if (cpShim::now_us - start > longest) {
+                longest = cpShim::now_us - start;
+            }
+        } while ((port.available() > 0) || ((q) && (q->pending())));
+    }
+
+    snprintf(note, sizeof(note), "%5.0f sim us on the bus, longest proceess() %lu sim us",
+             (double)Wire.busyMicros / Messages, longest);
+    report(name, (double)Wire.transactions / Messages, "I2C/msg", note);
+}
+
+static void setupNode(cpNode &node, MemStream &port, IOXBank *bank, IOXQueue *q) {
+    node.setCMRIPort(&port);
+    node.setNodeAddress(0);
+    IOX::begin();
+    if (bank) {
+        bank->add16(0x20, IOX::IN,  IOX::IN);
+        bank->add16(0x22, IOX::OUT, IOX::OUT);
+        bank->add16(0x23, IOX::OUT, IOX::OUT);
+        bank->begin(node);
+    } else {
+        IOX::init16(0x20, IOX::IN,  IOX::IN);
+        IOX::init16(0x22, IOX::OUT, IOX::OUT);
+        IOX::init16(0x23, IOX::OUT, IOX::OUT);
+        node.setNumInputBytes(4);
+        node.setNumOutputBytes(6);
+        node.setPackHandler(packPorts);
+        node.setUnpackHandler(unpackPorts);
+    }
+    node.setIOXQueue(q);
+}
+
+static void scenario(const char *title, IOXBank *bank, IOXQueue *q) {
+    cpNode node;
+    MemStream port;
+    std::vector< std::vector<byte> > all, one, none, poll;
+    byte a[6] = { 0, 0, 0x11, 0x22, 0x33, 0x44 };
+    byte b[6] = { 0, 0, 0xEE, 0xDD, 0xCC, 0xBB };
+    byte c[6] = { 0, 0, 0x11, 0x22, 0x33, 0x45 };
+
+    setupNode(node, port, bank, q);
+
+    all.push_back(frame(0, 'T', a, 6));
+    all.push_back(frame(0, 'T', b, 6));
+    one.push_back(frame(0, 'T', a, 6));
+    one.push_back(frame(0, 'T', c, 6));
+    none.push_back(frame(0, 'T', a, 6));
+    poll.push_back(frame(0, 'P'));
+
+    section(title);
+    run("T, all 4 expander bytes changed", node, port, q, all);
+    run("T, 1 expander byte changed", node, port, q, one);
+    run("T, nothing changed", node, port, q, none);
+    run("P", node, port, q, poll);
+}
+
+void benchIOX(void) {
+    IOXBank bank, queuedBank;
+    IOXQueue queue;
+
+    scenario("IOX per port in pack()/unpack()", NULL, NULL);
+    scenario("IOXBank", &bank, NULL);
+    scenario("IOXBank with an IOXQueue", &queuedBank, &queue);
+}
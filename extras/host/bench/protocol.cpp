@@ -0,0 +1,153 @@
+//==================================================================================
+//
+//  Protocol benchmarks: message throughput and poll to response latency
+//
+//==================================================================================
+
+#include "bench.h"
+
+using namespace bench;
+
+static const int Frames = 1000;         // frames per pass through the traffic
+static const byte DataBytes = 6;        // T message and R response size
+
+// ----------------------------------------------------------------------
+//  Frames per second through proceess(), for a stream of <traffic>
+//  holding <Frames> frames.  proceess() handles at most one message per
+//  call, so this is getPacket() and whatever the message leads to:
+//  unpack() for a T, the response for a P.
+// ----------------------------------------------------------------------
+static void parse(const char *name, const std::vector<byte> &traffic) {
+    cpNode node;
+    MemStream port;
+    char note[64];
+
+    node.setCMRIPort(&port);
+    node.setNodeAddress(0);
+    node.setNumOutputBytes(DataBytes);
+    port.feed(traffic);
+
+    double ns = hostNs([&]() {
+        port.rewind();
+        port.sent.clear();
+        while (port.available() > 0) {
+            node.proceess();
+        }
+    }, 10);
+
+    snprintf(note, sizeof(note), "%.1f ns/frame, %.2f ns/byte",
+             ns / Frames, ns / traffic.size());
+    report(name, 1e9 * Frames / ns, "frames/s", note);
+}
+
+static void parserThroughput(void) {
+    byte plain[DataBytes]  = { 0x55, 0xAA, 0x00, 0xFF, 0x12, 0x34 };
+    byte escaped[DataBytes] = { 0x02, 0x03, 0x10, 0x02, 0x03, 0x10 };
+    std::vector<byte> t, dle, poll, foreign, mixed, f;
+
+    for (int i = 0; i < Frames; i++) {
+        f = frame(0, 'T', plain, DataBytes);        t.insert(t.end(), f.begin(), f.end());
+        f = frame(0, 'T', escaped, DataBytes);      dle.insert(dle.end(), f.begin(), f.end());
+        f = frame(0, 'P');                          poll.insert(poll.end(), f.begin(), f.end());
+        f = frame(1 + (i % 63), 'T', plain, DataBytes);
+        foreign.insert(foreign.end(), f.begin(), f.end());
+        f = (i % 4 == 0) ? frame(0, 'P') : frame(1 + (i % 63), (i & 1) ? 'T' : 'R', escaped, DataBytes);
+        mixed.insert(mixed.end(), f.begin(), f.end());
+    }
+
+    section("Message throughput, proceess()");
+    parse("T frames, 6 data bytes", t);
+    parse("T frames, 6 DLE escaped data bytes", dle);
+    parse("P frames, answered", poll);
+    parse("T frames for other nodes (skipped)", foreign);
+    parse("bus traffic, 1 in 4 frames for this node", mixed);
+}
+
+
+// ----------------------------------------------------------------------
+//  Poll to response: one P message through proceess(), up to the
+//  response having been written to the port
+// ----------------------------------------------------------------------
+static byte inputs;
+
+static void packSame(byte *IB, int len) {
+    memset(IB, 0x5A, len);
+}
+
+static void packChanging(byte *IB, int len) {
+    memset(IB, inputs++, len);
+}
+
+static void pollResponse(void) {
+    std::vector<byte> p = frame(0, 'P');
+    char note[64];
+
+    section("Poll to response, proceess()");
+
+    {
+        cpNode node;
+        MemStream port;
+
+        node.setCMRIPort(&port);
+        node.setNodeAddress(0);
+        node.setNumInputBytes(DataBytes);
+        port.feed(p);
+
+        node.setPackHandler(packSame);
+        report("inputs unchanged (R frame reused)", hostNs([&]() {
+            port.rewind();
+            port.sent.clear();
+            node.proceess();
+        }), "host ns");
+
+        node.setPackHandler(packChanging);
+        report("inputs changed every poll", hostNs([&]() {
+            port.rewind();
+            port.sent.clear();
+            node.proceess();
+        }), "host ns");
+    }
+
+    // Four expander input bytes, read when the poll comes in, or
+    // sampled in the background beforehand
+    for (int background = 0; background <= 1; background++) {
+        cpNode node;
+        MemStream port;
+        IOXBank bank;
+        unsigned long polls = 0, lead = 0;
+
+        node.setCMRIPort(&port);
+        node.setNodeAddress(0);
+        bank.add16(0x20, IOX::IN, IOX::IN);
+        bank.add16(0x21, IOX::IN, IOX::IN);
+        bank.begin(node);
+        if (background) {
+            node.setInputSamplePeriod(2000);
+        }
+        port.feed(p);
+
+        Wire.resetStats();
+        double ns = hostNs([&]() {
+            if (background) {
+                cpShim::advance(2000);
+                node.proceess();                    // takes the background sample
+            }
+            port.rewind();
+            port.sent.clear();
+            node.proceess();                        // answers the poll
+            lead += node.getTXEnableDelay();
+            polls++;
+        });
+
+        snprintf(note, sizeof(note), "%.1f I2C transactions/poll, %.1f host ns",
+                 (double)Wire.transactions / polls, ns);
+        report(background ? "4 expander bytes, sampled in the background"
+                          : "4 expander bytes, read on poll",
+               (double)lead / polls, "sim us", note);
+    }
+}
+
+void benchProtocol(void) {
+    parserThroughput();
+    pollResponse();
+}
@@ -0,0 +1,188 @@
+//==================================================================================
+//
+//  Shift register benchmarks: 16 expander bytes on 74HC595/74HC165 chains
+//  over SPI (cpShiftChain), against MCP23017s over I2C (IOX)
+//
+//  The node has the 2 onboard bytes and 16 expander bytes, either all
+//  outputs (8 MCP23017s, or 16 595s) or all inputs (8 MCP23017s, or 16
+//  165s).  Every T message changes every output byte, and every input
+//  byte changes before each P message; what the expanders end up with,
+//  and what the node reports, is checked against what it should be.
+//
+//==================================================================================
+
+#include "bench.h"
+#include <SPI.h>
+#include <cpShiftChain.h>
+
+using namespace bench;
+
+static const int  Messages = 200;
+static const byte Bytes    = 16;
+static const byte Devices  = Bytes / 2;
+static const byte LatchPin = 10;
+static const byte LoadPin  = 9;
+
+static cpShiftChain<LatchPin, LoadPin> chain;
+
+enum { PER_PORT, BANK, CHAIN };
+
+static void packPorts(byte *IB, int len) {
+    for (byte d = 0; (d < Devices) && (3 + 2 * d < len); d++) {
+        IB[2 + 2 * d] = IOX::read(0x20 + d, IOX::PORT_A);
+        IB[3 + 2 * d] = IOX::read(0x20 + d, IOX::PORT_B);
+    }
+}
+
+static void unpackPorts(byte *OB, int len) {
+    for (byte d = 0; (d < Devices) && (3 + 2 * d < len); d++) {
+        IOX::write(0x20 + d, IOX::PORT_A, OB[2 + 2 * d]);
+        IOX::write(0x20 + d, IOX::PORT_B, OB[3 + 2 * d]);
+    }
+}
+
+static void packChain(byte *IB, int len)    { chain.read(&IB[2], len - 2); }
+static void unpackChain(byte *OB, int len)  { chain.write(&OB[2], len - 2); }
+
+// Expander byte b of message i: every byte changes from one message to the next
+static byte image(int i, byte b) {
+    return (byte)(0x5A + 29 * b) ^ ((i & 1) ? 0xFF : 0x00);
+}
+
+// The input bytes of the R message the node sent, DLE escapes removed
+static std::vector<byte> response(const std::vector<byte> &sent) {
+    std::vector<byte> r;
+
+    for (size_t i = 5; (i < sent.size()) && (sent[i] != 0x03); i++) {
+        if (sent[i] == 0x10) {
+            i++;
+        }
+        r.push_back(sent[i]);
+    }
+    return r;
+}
+
+// When the MCP23017 port behind expander byte b was last written (outputs) or read
+static unsigned long ioxTime(byte b, bool outputs) {
+    cpShimMCP23017 *dev = Wire.device(0x20 + b / 2);
+    return outputs ? dev->outputMicros[b & 1] : dev->readMicros[b & 1];
+}
+
+// ----------------------------------------------------------------------
+//  <Messages> T messages (outputs) or P messages (inputs) through a
+//  node using <kind> of expander.  The first one goes through untimed.
+// ----------------------------------------------------------------------
+static void run(const char *name, int kind, bool outputs, unsigned long clock) {
+    cpNode node;
+    MemStream port;
+    IOXBank bank;
+    byte data[2 + Bytes];
+    double spread = 0;
+    unsigned long wrong = 0;
+    unsigned long latches = 0;
+    char note[100];
+
+    node.setCMRIPort(&port);
+    node.setNodeAddress(0);
+    if (kind == CHAIN) {
+        SPI.chain.attach595(LatchPin, outputs ? Bytes : 0);
+        SPI.chain.attach165(LoadPin,  outputs ? 0 : Bytes);
+        chain.begin(clock);
+        node.setNumInputBytes(outputs ? 2 : 2 + Bytes);
+        node.setNumOutputBytes(outputs ? 2 + Bytes : 2);
+        node.setPackHandler(packChain);
+        node.setUnpackHandler(unpackChain);
+    } else {
+        IOX::begin(clock);
+        for (byte d = 0; d < Devices; d++) {
+            if (kind == BANK) {
+                bank.add16(0x20 + d, !outputs, !outputs);
+            } else {
+                IOX::init16(0x20 + d, !outputs, !outputs);
+            }
+        }
+        if (kind == BANK) {
+            bank.begin(node);
+        } else {
+            node.setNumInputBytes(outputs ? 2 : 2 + Bytes);
+            node.setNumOutputBytes(outputs ? 2 + Bytes : 2);
+            node.setPackHandler(packPorts);
+            node.setUnpackHandler(unpackPorts);
+        }
+    }
+
+    for (int i = -1; i < Messages; i++) {
+        unsigned long first = 0, last = 0;
+        unsigned long latched = SPI.chain.latches;
+
+        if (i == 0) {
+            Wire.resetStats();
+            SPI.resetStats();
+        }
+        port.clear();
+        data[0] = data[1] = 0;
+        for (byte b = 0; b < Bytes; b++) {
+            data[2 + b] = image(i, b);
+            if (!outputs) {
+                if (kind == CHAIN) {
+                    SPI.chain.setInputs(b, data[2 + b]);
+                } else {
+                    Wire.device(0x20 + b / 2)->setInputs(b & 1, ~data[2 + b]);     // IOX inputs are active low
+                }
+            }
+        }
+        port.feed(outputs ? frame(0, 'T', data, sizeof(data)) : frame(0, 'P'));
+        do {
+            node.proceess();
+        } while ((port.available() > 0) || (node.isTransmitting()));
+        cpShim::advance(100);                       // room between messages
+
+        std::vector<byte> r = response(port.sent);
+        for (byte b = 0; b < Bytes; b++) {
+            byte got;
+            if (outputs) {
+                got = (kind == CHAIN) ? SPI.chain.getOutputs(b) : Wire.device(0x20 + b / 2)->getOutputs(b & 1);
+            } else {
+                got = (r.size() == 2u + Bytes) ? r[2 + b] : ~data[2 + b];
+            }
+            wrong += (got != data[2 + b]);
+            if (kind != CHAIN) {
+                unsigned long t = ioxTime(b, outputs);
+                if ((b == 0) || (t < first)) first = t;     // the clock is past 32 bits by now
+                if ((b == 0) || (t > last))  last = t;
+            }
+        }
+        if (i >= 0) {
+            spread += (kind == CHAIN) ? 0 : (last - first);
+            latches += SPI.chain.latches - latched;
+        }
+    }
+
+    if (kind == CHAIN) {
+        if (outputs) {
+            snprintf(note, sizeof(note), "%4.1f SPI/msg, change on %3.1f latch edges, %lu bytes wrong",
+                     (double)SPI.transactions / Messages, (double)latches / Messages, wrong);
+        } else {
+            snprintf(note, sizeof(note), "%4.1f SPI/msg, sampled by one load pulse, %lu bytes wrong",
+                     (double)SPI.transactions / Messages, wrong);
+        }
+        report(name, (double)SPI.busyMicros / Messages, "sim us/msg", note);
+    } else {
+        snprintf(note, sizeof(note), "%4.1f I2C/msg, %s over %5.0f sim us, %lu bytes wrong",
+                 (double)Wire.transactions / Messages, outputs ? "change" : "sampled",
+                 spread / Messages, wrong);
+        report(name, (double)Wire.busyMicros / Messages, "sim us/msg", note);
+    }
+}
+
+void benchShift(void) {
+    for (int outputs = 1; outputs >= 0; outputs--) {
+        section(outputs ? "16 output bytes, T message changing all of them"
+                        : "16 input bytes, P message after all of them changed");
+        run("IOX per port, 100 kHz",         PER_PORT, outputs, 100000);
+        run("IOXBank, 100 kHz",              BANK,     outputs, 100000);
+        run("IOXBank, 400 kHz",              BANK,     outputs, 400000);
+        run("cpShiftChain, 4 MHz",           CHAIN,    outputs, 4000000);
+        run("cpShiftChain, 8 MHz",           CHAIN,    outputs, 8000000);
+    }
+}
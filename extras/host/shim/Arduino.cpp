@@ -0,0 +1,155 @@
+//==================================================================================
+//
+//  Arduino.cpp - Host stand-in for the Arduino core, see Arduino.h
+//
+//==================================================================================
+
+#include <Arduino.h>
+
+namespace cpShim {
+    uint64_t now_us = 0;
+    volatile uint8_t regs[RegCount];
+}
+
+// Both wrap around at 32 bits, as on the AVR
+unsigned long micros(void)                  { return (uint32_t)cpShim::now_us; }
+unsigned long millis(void)                  { return (uint32_t)(cpShim::now_us / 1000); }
+void delay(unsigned long ms)                { cpShim::now_us += ms * 1000; }
+void delayMicroseconds(unsigned int us)     { cpShim::now_us += us; }
+
+
+// ----------------------------------------------------------------------
+//  Pin tables as in the AVR core's pins_arduino.h for the ATmega328P,
+//  with the same lookups per call, so that digitalRead()/digitalWrite()
+//  cost about what they cost relative to direct register access.
+// ----------------------------------------------------------------------
+namespace {
+    enum { NOT_A_PORT = 0, PB = 2, PC = 3, PD = 4 };
+    enum { NOT_ON_TIMER = 0, TIMER0A, TIMER0B, TIMER1A, TIMER1B, TIMER2A, TIMER2B };
+
+    const uint8_t digital_pin_to_port[NUM_DIGITAL_PINS] = {
+        PD, PD, PD, PD, PD, PD, PD, PD,         // D0-D7
+        PB, PB, PB, PB, PB, PB,                 // D8-D13
+        PC, PC, PC, PC, PC, PC,                 // A0-A5
+    };
+    const uint8_t digital_pin_to_bit_mask[NUM_DIGITAL_PINS] = {
+        0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+        0x01, 0x02, 0x04, 0x08, 0x10, 0x20,
+        0x01, 0x02, 0x04, 0x08, 0x10, 0x20,
+    };
+    const uint8_t digital_pin_to_timer[NUM_DIGITAL_PINS] = {
+        NOT_ON_TIMER, NOT_ON_TIMER, NOT_ON_TIMER, TIMER2B, NOT_ON_TIMER, TIMER0B, TIMER0A, NOT_ON_TIMER,
+        NOT_ON_TIMER, TIMER1A, TIMER1B, TIMER2A, NOT_ON_TIMER, NOT_ON_TIMER,
+        NOT_ON_TIMER, NOT_ON_TIMER, NOT_ON_TIMER, NOT_ON_TIMER, NOT_ON_TIMER, NOT_ON_TIMER,
+    };
+
+    volatile uint8_t *portInputRegister(uint8_t port) {
+        return &cpShim::regs[cpShim::REG_PINB + 3 * (port - PB)];
+    }
+    volatile uint8_t *portModeRegister(uint8_t port) {
+        return &cpShim::regs[cpShim::REG_DDRB + 3 * (port - PB)];
+    }
+    volatile uint8_t *portOutputRegister(uint8_t port) {
+        return &cpShim::regs[cpShim::REG_PORTB + 3 * (port - PB)];
+    }
+
+    void turnOffPWM(uint8_t timer) {
+        switch (timer) {
+        case TIMER0A:   cpShim::regs[cpShim::REG_TCCR0A] &= ~0x80;    break;
+        case TIMER0B:   cpShim::regs[cpShim::REG_TCCR0A] &= ~0x20;    break;
+        case TIMER1A:   cpShim::regs[cpShim::REG_TCCR1A] &= ~0x80;    break;
+        case TIMER1B:   cpShim::regs[cpShim::REG_TCCR1A] &= ~0x20;    break;
+        case TIMER2A:   cpShim::regs[cpShim::REG_TCCR2A] &= ~0x80;    break;
+        case TIMER2B:   cpShim::regs[cpShim::REG_TCCR2A] &= ~0x20;    break;
+        }
+    }
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    uint8_t port = (pin < NUM_DIGITAL_PINS) ? digital_pin_to_port[pin] : (uint8_t)NOT_A_PORT;
+    uint8_t bit;
+    uint8_t oldSREG;
+
+    if (port == NOT_A_PORT) {
+        return;
+    }
+    bit = digital_pin_to_bit_mask[pin];
+    volatile uint8_t *reg = portModeRegister(port);
+    volatile uint8_t *out = portOutputRegister(port);
+
+    oldSREG = SREG;
+    cli();
+    if (mode == INPUT) {
+        *reg &= ~bit;
+        *out &= ~bit;
+    } else if (mode == INPUT_PULLUP) {
+        *reg &= ~bit;
+        *out |= bit;
+    } else {
+        *reg |= bit;
+    }
+    SREG = oldSREG;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    uint8_t port = (pin < NUM_DIGITAL_PINS) ? digital_pin_to_port[pin] : (uint8_t)NOT_A_PORT;
+    uint8_t bit;
+    uint8_t timer;
+    uint8_t oldSREG;
+
+    if (port == NOT_A_PORT) {
+        return;
+    }
+    timer = digital_pin_to_timer[pin];
+    bit = digital_pin_to_bit_mask[pin];
+    if (timer != NOT_ON_TIMER) {
+        turnOffPWM(timer);
+    }
+    volatile uint8_t *out = portOutputRegister(port);
+
+    oldSREG = SREG;
+    cli();
+    if (val == LOW) {
+        *out &= ~bit;
+    } else {
+        *out |= bit;
+    }
+    SREG = oldSREG;
+}
+
+int digitalRead(uint8_t pin) {
+    uint8_t port = (pin < NUM_DIGITAL_PINS) ? digital_pin_to_port[pin] : (uint8_t)NOT_A_PORT;
+    uint8_t bit;
+    uint8_t timer;
+
+    if (port == NOT_A_PORT) {
+        return LOW;
+    }
+    timer = digital_pin_to_timer[pin];
+    bit = digital_pin_to_bit_mask[pin];
+    if (timer != NOT_ON_TIMER) {
+        turnOffPWM(timer);
+    }
+    if (*portInputRegister(port) & bit) {
+        return HIGH;
+    }
+    return LOW;
+}
+
+void cpShim::setPin(uint8_t pin, bool level) {
+    if (pin < NUM_DIGITAL_PINS) {
+        volatile uint8_t *in = portInputRegister(digital_pin_to_port[pin]);
+        if (level) {
+            *in |= digital_pin_to_bit_mask[pin];
+        } else {
+            *in &= ~digital_pin_to_bit_mask[pin];
+        }
+    }
+}
+
+bool cpShim::getPin(uint8_t pin) {
+    if (pin < NUM_DIGITAL_PINS) {
+        return (*portOutputRegister(digital_pin_to_port[pin]) & digital_pin_to_bit_mask[pin]) != 0;
+    }
+    return false;
+}
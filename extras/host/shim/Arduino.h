@@ -0,0 +1,157 @@
+#pragma once
+
+/*
+    ==================================================================================
+                  Arduino.h             Host (Linux) stand-in for the Arduino core
+    ==================================================================================
+
+    Just enough of the Arduino core for the cpNode library to build unchanged
+    with a native compiler, so it can be benchmarked without hardware:
+
+      - micros() and millis() read a simulated clock that only moves when
+        something moves it: cpShim::advance(), delay(), delayMicroseconds(),
+        or an I2C transfer on the simulated Wire bus.  cpShim::now_us itself
+        is 64 bits wide, but micros() and millis() wrap around at 32 bits as
+        they do on the AVR, so the library's wraparound handling gets used.
+
+      - The board is an ATmega328P (Pro Mini, Uno).  digitalRead(),
+        digitalWrite() and pinMode() go through the same pin to port tables
+        as the AVR core, onto fake PINx / PORTx / DDRx registers, which are
+        also what cpPinMap's direct register access uses.  Input levels are
+        set with cpShim::setPin().
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef __AVR_ATmega328P__
+#define __AVR_ATmega328P__  1
+#endif
+
+typedef uint8_t byte;
+typedef bool    boolean;
+
+#define HIGH            1
+#define LOW             0
+#define INPUT           0
+#define OUTPUT          1
+#define INPUT_PULLUP    2
+
+#define A0  14
+#define A1  15
+#define A2  16
+#define A3  17
+#define A4  18
+#define A5  19
+#define NUM_DIGITAL_PINS    20
+
+#define BIN 2
+#define OCT 8
+#define DEC 10
+#define HEX 16
+
+#define F(s)    (s)
+
+unsigned long micros(void);
+unsigned long millis(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int  digitalRead(uint8_t pin);
+
+namespace cpShim {
+    extern uint64_t now_us;                         // the simulated clock
+    inline void advance(unsigned long us)       { now_us += us; }
+
+    // ATmega328P I/O registers
+    enum {
+        REG_PINB = 0, REG_DDRB, REG_PORTB,
+        REG_PINC,     REG_DDRC, REG_PORTC,
+        REG_PIND,     REG_DDRD, REG_PORTD,
+        REG_TCCR0A, REG_TCCR1A, REG_TCCR2A,
+        REG_SREG,
+        RegCount
+    };
+    extern volatile uint8_t regs[RegCount];
+
+    void setPin(uint8_t pin, bool level);           // drive an input pin from outside
+    bool getPin(uint8_t pin);                       // level an output pin is driving
+}
+
+#define PINB    (cpShim::regs[cpShim::REG_PINB])
+#define DDRB    (cpShim::regs[cpShim::REG_DDRB])
+#define PORTB   (cpShim::regs[cpShim::REG_PORTB])
+#define PINC    (cpShim::regs[cpShim::REG_PINC])
+#define DDRC    (cpShim::regs[cpShim::REG_DDRC])
+#define PORTC   (cpShim::regs[cpShim::REG_PORTC])
+#define PIND    (cpShim::regs[cpShim::REG_PIND])
+#define DDRD    (cpShim::regs[cpShim::REG_DDRD])
+#define PORTD   (cpShim::regs[cpShim::REG_PORTD])
+#define SREG    (cpShim::regs[cpShim::REG_SREG])
+
+inline void cli(void)   { SREG &= ~0x80; }
+inline void sei(void)   { SREG |=  0x80; }
+
+
+// --------------------------------------------------------------------------
+//  Print and Stream
+// --------------------------------------------------------------------------
+class Print {
+public:
+    virtual ~Print() { }
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t n) {
+        size_t r = 0;
+        while (n--) {
+            r += write(*buf++);
+        }
+        return r;
+    }
+    size_t write(const char *s)                 { return write((const uint8_t *)s, strlen(s)); }
+    virtual int availableForWrite(void)         { return 0; }
+    virtual void flush(void)                    { }
+
+    size_t print(const char *s)                 { return write(s); }
+    size_t print(char c)                        { return write((uint8_t)c); }
+    size_t print(unsigned char n, int base = DEC)   { return printNumber(n, base); }
+    size_t print(int n, int base = DEC)             { return print((long)n, base); }
+    size_t print(unsigned int n, int base = DEC)    { return printNumber(n, base); }
+    size_t print(long n, int base = DEC) {
+        if ((base == DEC) && (n < 0)) {
+            return write('-') + printNumber(-(unsigned long)n, DEC);
+        }
+        return printNumber(n, base);
+    }
+    size_t print(unsigned long n, int base = DEC)   { return printNumber(n, base); }
+
+    size_t println(void)                        { return write("\r\n"); }
+    template<typename T>
+    size_t println(T v)                         { return print(v) + println(); }
+    template<typename T>
+    size_t println(T v, int base)               { return print(v, base) + println(); }
+
+private:
+    size_t printNumber(unsigned long n, int base) {
+        char buf[8 * sizeof(long) + 1];
+        char *s = &buf[sizeof(buf) - 1];
+        *s = '\0';
+        do {
+            byte d = n % base;
+            *--s = (d < 10) ? ('0' + d) : ('A' + d - 10);
+            n /= base;
+        } while (n);
+        return write(s);
+    }
+};
+
+class Stream : public Print {
+public:
+    virtual int available(void) = 0;
+    virtual int read(void) = 0;
+    virtual int peek(void) = 0;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+/*
+    ==================================================================================
+                  MemStream             In-memory Stream for the CMRI port
+    ==================================================================================
+
+    Bytes given to feed() are what the node reads; bytes the node writes
+    are kept in sent.  rewind() replays the same input again, so a
+    benchmark can build its traffic once and run it many times.
+*/
+
+#include <Arduino.h>
+#include <vector>
+
+class MemStream : public Stream {
+public:
+    MemStream(void) : pos(0), room(64) { }
+
+    void feed(const byte *buf, size_t n)        { in.insert(in.end(), buf, buf + n); }
+    void feed(const std::vector<byte> &buf)     { in.insert(in.end(), buf.begin(), buf.end()); }
+    void rewind(void)                           { pos = 0; }
+    void clear(void)                            { in.clear(); pos = 0; sent.clear(); }
+
+    int available(void)                         { return (int)(in.size() - pos); }
+    int read(void)                              { return (pos < in.size()) ? in[pos++] : -1; }
+    int peek(void)                              { return (pos < in.size()) ? in[pos] : -1; }
+
+    size_t write(uint8_t c)                     { sent.push_back(c); return 1; }
+    size_t write(const uint8_t *buf, size_t n)  { sent.insert(sent.end(), buf, buf + n); return n; }
+    int availableForWrite(void)                 { return room; }
+
+    std::vector<byte> sent;
+
+private:
+    std::vector<byte> in;
+    size_t pos;
+    int room;                                       // what availableForWrite() reports
+};
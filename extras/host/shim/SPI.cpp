@@ -0,0 +1,111 @@
+//==================================================================================
+//
+//  SPI.cpp - Host stand-in for the Arduino SPI library, see SPI.h
+//
+//==================================================================================
+
+#include <SPI.h>
+
+SPIClass SPI;
+
+cpShimShiftChain::cpShimShiftChain(void) {
+    latch_pin = load_pin = 0xFF;
+    n595 = n165 = 0;
+    latch_low = false;
+    latches = 0;
+    latchMicros = 0;
+    memset(out_sr, 0, sizeof(out_sr));
+    memset(out_pins, 0, sizeof(out_pins));
+    memset(in_sr, 0, sizeof(in_sr));
+    memset(in_pins, 0, sizeof(in_pins));
+}
+
+void cpShimShiftChain::attach595(byte latchPin, byte chips) {
+    latch_pin = latchPin;
+    n595 = (chips > MaxChips) ? MaxChips : chips;
+}
+
+void cpShimShiftChain::attach165(byte loadPin, byte chips) {
+    load_pin = loadPin;
+    n165 = (chips > MaxChips) ? MaxChips : chips;
+}
+
+void cpShimShiftChain::begin(void) {
+    if ((n165) && (!cpShim::getPin(load_pin))) {
+        memcpy(in_sr, in_pins, n165);               // parallel load
+    }
+}
+
+// ----------------------------------------------------------------------
+//  One byte: MOSI goes into the first 595 and everything moves one chip
+//  along; MISO is the first 165's shift register, and the rest move one
+//  chip nearer, with 0s coming in at the far end.
+// ----------------------------------------------------------------------
+byte cpShimShiftChain::shift(byte mosi) {
+    byte miso = 0;
+
+    if (n595) {
+        memmove(&out_sr[1], &out_sr[0], n595 - 1);
+        out_sr[0] = mosi;
+        if (!cpShim::getPin(latch_pin)) {
+            latch_low = true;
+        }
+    }
+    if (n165) {
+        if (!cpShim::getPin(load_pin)) {
+            memcpy(in_sr, in_pins, n165);           // still loading: QH stays on input H
+            return in_sr[0];
+        }
+        miso = in_sr[0];
+        memmove(&in_sr[0], &in_sr[1], n165 - 1);
+        in_sr[n165 - 1] = 0;
+    }
+    return miso;
+}
+
+void cpShimShiftChain::end(void) {
+    if ((n595) && (latch_low) && (cpShim::getPin(latch_pin))) {
+        memcpy(out_pins, out_sr, n595);
+        latches++;
+        latchMicros = cpShim::now_us;
+    }
+    latch_low = false;
+}
+
+
+SPIClass::SPIClass(void) {
+    clock = 4000000;
+    resetStats();
+}
+
+void SPIClass::beginTransaction(const SPISettings &s) {
+    clock = s.clock;
+    transactions++;
+    chain.begin();
+}
+
+void SPIClass::endTransaction(void) {
+    chain.end();
+}
+
+// 8 bit times per byte; the fractions of a microsecond are carried over
+uint8_t SPIClass::transfer(uint8_t c) {
+    unsigned long us;
+
+    bytes++;
+    busy_ns += (8ULL * 1000000000ULL) / clock;
+    us = busy_ns / 1000;
+    busy_ns -= us * 1000;
+    busyMicros += us;
+    cpShim::advance(us);
+    return chain.shift(c);
+}
+
+void SPIClass::transfer(void *buf, size_t n) {
+    uint8_t *p = (uint8_t *)buf;
+
+    while (n--) {
+        *p = transfer(*p);
+        p++;
+    }
+}
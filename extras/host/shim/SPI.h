@@ -0,0 +1,94 @@
+#pragma once
+
+/*
+    ==================================================================================
+                  SPI.h                 Host stand-in for the Arduino SPI library
+    ==================================================================================
+
+    What is wired to the bus is a chain of 74HC595s on MOSI and a chain of
+    74HC165s on MISO, sharing SCK, as cpShiftChain expects.  The chips
+    only see what the pins were doing at each SPI call, so the model
+    infers the edges from that:
+
+      - a 595 latch (RCLK) that was low during the transfers and is high
+        at endTransaction() has had its rising edge: the outputs latch
+      - a 165 load (SH/LD) that is low at beginTransaction() or during a
+        transfer parallel loads the inputs; shifting needs it high
+
+    Every byte moves the simulated clock (see micros()) by 8 bit times at
+    the SPISettings clock rate, so SPI waits show up in simulated time.
+*/
+
+#include <Arduino.h>
+
+#define MSBFIRST    1
+#define LSBFIRST    0
+#define SPI_MODE0   0x00
+#define SPI_MODE1   0x04
+#define SPI_MODE2   0x08
+#define SPI_MODE3   0x0C
+
+class SPISettings {
+public:
+    SPISettings(void) : clock(4000000), bitOrder(MSBFIRST), dataMode(SPI_MODE0) { }
+    SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode)
+        : clock(clock), bitOrder(bitOrder), dataMode(dataMode) { }
+
+    uint32_t clock;
+    uint8_t bitOrder;
+    uint8_t dataMode;
+};
+
+class cpShimShiftChain {
+public:
+    static const byte MaxChips = 32;
+
+    cpShimShiftChain(void);
+
+    void attach595(byte latchPin, byte chips);      // output chain, 0 chips = none
+    void attach165(byte loadPin, byte chips);       // input chain
+
+    void setInputs(byte chip, byte levels)      { if (chip < MaxChips) in_pins[chip] = levels; }
+    byte getOutputs(byte chip)                  { return (chip < MaxChips) ? out_pins[chip] : 0; }
+
+    unsigned long latches;                          // 595 latch edges
+    unsigned long latchMicros;                      // cpShim::now_us at the last one
+
+    // Used by SPIClass
+    void begin(void);
+    byte shift(byte mosi);
+    void end(void);
+
+private:
+    byte latch_pin, load_pin;
+    byte n595, n165;
+    bool latch_low;                                 // the latch was low during a transfer
+    byte out_sr[MaxChips], out_pins[MaxChips];      // 595 shift registers and output pins
+    byte in_sr[MaxChips], in_pins[MaxChips];        // 165 shift registers and input pins
+};
+
+class SPIClass {
+public:
+    SPIClass(void);
+
+    void begin(void)                            { }
+    void end(void)                              { }
+    void beginTransaction(const SPISettings &s);
+    void endTransaction(void);
+    uint8_t transfer(uint8_t c);
+    void transfer(void *buf, size_t n);
+
+    cpShimShiftChain chain;                         // what is wired to the bus
+
+    // Bus statistics, cleared by resetStats()
+    unsigned long transactions;
+    unsigned long bytes;
+    unsigned long busyMicros;                       // time the bus was busy
+    void resetStats(void)                       { transactions = 0; bytes = 0; busyMicros = 0; busy_ns = 0; }
+
+private:
+    uint32_t clock;
+    unsigned long busy_ns;                          // bus time not yet added to the clock
+};
+
+extern SPIClass SPI;
@@ -0,0 +1,174 @@
+//==================================================================================
+//
+//  Wire.cpp - Host stand-in for the Arduino Wire library, see Wire.h
+//
+//==================================================================================
+
+#include <Wire.h>
+
+TwoWire Wire;
+
+// MCP23017 registers, IOCON.BANK = 0
+enum {
+    IODIR   = 0x00,
+    IPOL    = 0x02,
+    GPINTEN = 0x04,
+    DEFVAL  = 0x06,
+    INTCON  = 0x08,
+    IOCON   = 0x0A,
+    GPPU    = 0x0C,
+    INTF    = 0x0E,
+    INTCAP  = 0x10,
+    GPIO    = 0x12,
+    OLAT    = 0x14,
+};
+
+void cpShimMCP23017::reset(void) {
+    memset(reg, 0, sizeof(reg));
+    reg[IODIR] = reg[IODIR + 1] = 0xFF;         // all inputs at power on
+    pins[0] = pins[1] = 0;
+    outputMicros[0] = outputMicros[1] = 0;
+    readMicros[0] = readMicros[1] = 0;
+}
+
+// ----------------------------------------------------------------------
+//  New levels on a port's pins.  An input with interrupt on change
+//  enabled that changes (or differs from DEFVAL) sets its INTF bit, and
+//  the port is captured in INTCAP if it had no interrupt pending.
+// ----------------------------------------------------------------------
+void cpShimMCP23017::setInputs(byte port, byte levels) {
+    byte p = port & 1;
+    byte compare = (pins[p] & ~reg[INTCON + p]) | (reg[DEFVAL + p] & reg[INTCON + p]);
+    byte fired = (levels ^ compare) & reg[GPINTEN + p] & reg[IODIR + p];
+
+    pins[p] = levels;
+    if (fired) {
+        if (reg[INTF + p] == 0) {
+            reg[INTCAP + p] = (levels ^ reg[IPOL + p]) & reg[IODIR + p];
+        }
+        reg[INTF + p] |= fired;
+    }
+}
+
+void cpShimMCP23017::writeRegister(byte r, byte v) {
+    switch (r) {
+    case IOCON:     // FALLTHROUGH
+    case IOCON + 1: reg[IOCON] = reg[IOCON + 1] = v;    break;
+    case INTF:      // FALLTHROUGH
+    case INTF + 1:  // FALLTHROUGH
+    case INTCAP:    // FALLTHROUGH
+    case INTCAP + 1:    break;                          // read only
+    case GPIO:      // FALLTHROUGH
+    case GPIO + 1:  r = OLAT + (r - GPIO);
+                    // FALLTHROUGH
+    case OLAT:      // FALLTHROUGH
+    case OLAT + 1:  if (reg[r] != v) {
+                        reg[r] = v;
+                        outputMicros[r & 1] = cpShim::now_us;
+                    }
+                    break;
+    default:        if (r < Registers) reg[r] = v;      break;
+    }
+}
+
+byte cpShimMCP23017::readRegister(byte r) {
+    byte p = r & 1;
+    byte v;
+
+    switch (r) {
+    case GPIO:      // FALLTHROUGH
+    case GPIO + 1:  v = (((pins[p] ^ reg[IPOL + p]) & reg[IODIR + p]) | (reg[OLAT + p] & ~reg[IODIR + p]));
+                    reg[INTF + p] = 0;                  // reading GPIO or INTCAP clears the interrupt
+                    readMicros[p] = cpShim::now_us;
+                    return v;
+    case INTCAP:    // FALLTHROUGH
+    case INTCAP + 1:    v = reg[r];
+                    reg[INTF + p] = 0;
+                    return v;
+    default:        return (r < Registers) ? reg[r] : 0;
+    }
+}
+
+
+TwoWire::TwoWire(void) {
+    clock = 100000;
+    tx_address = -1;
+    tx_havePointer = false;
+    tx_len = 0;
+    memset(pointer, 0, sizeof(pointer));
+    rx_len = rx_pos = 0;
+    present = 0xFF;
+    resetStats();
+}
+
+cpShimMCP23017 *TwoWire::device(int address) {
+    byte d = address - FirstAddress;
+    if ((address < FirstAddress) || (d >= Devices) || !(present & (1 << d))) {
+        return NULL;
+    }
+    return &devices[d];
+}
+
+// Start, <n> bytes of 8 bits and an ACK, stop
+void TwoWire::transfer(unsigned int n) {
+    unsigned long us = ((9UL * n + 2) * 1000000UL + clock - 1) / clock;
+
+    transactions++;
+    bytes += n;
+    busyMicros += us;
+    cpShim::advance(us);
+}
+
+void TwoWire::beginTransmission(int address) {
+    tx_address = address;
+    tx_havePointer = false;
+    tx_len = 0;
+}
+
+// ----------------------------------------------------------------------
+//  The bytes are only counted here, and go to the device right away:
+//  the first one sets the register pointer, the rest are written to
+//  consecutive registers.
+// ----------------------------------------------------------------------
+size_t TwoWire::write(uint8_t c) {
+    cpShimMCP23017 *dev = device(tx_address);
+
+    tx_len++;
+    if (dev) {
+        byte *ptr = &pointer[tx_address - FirstAddress];
+        if (!tx_havePointer) {
+            *ptr = c % cpShimMCP23017::Registers;
+            tx_havePointer = true;
+        } else {
+            dev->writeRegister(*ptr, c);
+            *ptr = (*ptr + 1) % cpShimMCP23017::Registers;
+        }
+    }
+    return 1;
+}
+
+uint8_t TwoWire::endTransmission(bool) {
+    transfer(1 + tx_len);
+    tx_len = 0;
+    return device(tx_address) ? 0 : 2;              // 2: address NACK
+}
+
+uint8_t TwoWire::requestFrom(int address, int n, bool) {
+    cpShimMCP23017 *dev = device(address);
+
+    rx_len = rx_pos = 0;
+    if (n > (int)sizeof(rx)) {
+        n = sizeof(rx);
+    }
+    if (!dev) {
+        transfer(1);
+        return 0;
+    }
+    byte *ptr = &pointer[address - FirstAddress];
+    for (int i = 0; i < n; i++) {
+        rx[rx_len++] = dev->readRegister(*ptr);
+        *ptr = (*ptr + 1) % cpShimMCP23017::Registers;
+    }
+    transfer(1 + n);
+    return n;
+}
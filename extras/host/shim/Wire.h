@@ -0,0 +1,91 @@
+#pragma once
+
+/*
+    ==================================================================================
+                  Wire.h                Host stand-in for the Arduino Wire (I2C) library
+    ==================================================================================
+
+    The bus has a simulated MCP23017 at each of 0x20..0x27.  Writes and
+    reads go to the device registers (IOCON.BANK = 0, sequential mode, so
+    the register pointer steps through the interleaved A/B map), inputs
+    follow whatever cpShimMCP23017::setInputs() last set, and interrupt on
+    change is captured in INTF/INTCAP the way the chip does it.
+
+    Every transfer is counted, and moves the simulated clock (see micros())
+    by the time it would take on the wire at the setClock() rate, 9 bits
+    per byte plus start and stop, so I2C waits show up in simulated time.
+*/
+
+#include <Arduino.h>
+
+class cpShimMCP23017 {
+public:
+    static const byte Registers = 0x16;
+
+    cpShimMCP23017(void)                        { reset(); }
+    void reset(void);
+
+    void setInputs(byte port, byte levels);         // what is wired to GPIOA (0) / GPIOB (1)
+    byte getOutputs(byte port)                  { return reg[0x14 + port] & ~reg[port]; }   // OLAT bits set as outputs
+    byte getRegister(byte r)                    { return (r < Registers) ? reg[r] : 0; }
+
+    void writeRegister(byte r, byte v);
+    byte readRegister(byte r);
+
+    unsigned long outputMicros[2];                  // cpShim::now_us when each port's OLAT last changed
+    unsigned long readMicros[2];                    //   ... and its GPIO was last read
+
+private:
+    byte reg[Registers];
+    byte pins[2];
+};
+
+class TwoWire : public Stream {
+public:
+    static const byte FirstAddress = 0x20;
+    static const byte Devices = 8;
+
+    TwoWire(void);
+
+    void begin(void)                            { }
+    void setClock(uint32_t hz)                  { clock = hz; }
+
+    void beginTransmission(int address);
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buf, size_t n)  { return Print::write(buf, n); }
+    size_t write(int n)                         { return write((uint8_t)n); }
+    size_t write(unsigned int n)                { return write((uint8_t)n); }
+    size_t write(long n)                        { return write((uint8_t)n); }
+    size_t write(unsigned long n)               { return write((uint8_t)n); }
+    uint8_t endTransmission(bool stop = true);
+    uint8_t requestFrom(int address, int n, bool stop = true);
+
+    int available(void)                         { return rx_len - rx_pos; }
+    int read(void)                              { return (rx_pos < rx_len) ? rx[rx_pos++] : -1; }
+    int peek(void)                              { return (rx_pos < rx_len) ? rx[rx_pos] : -1; }
+
+    cpShimMCP23017 *device(int address);            // NULL if nothing answers there
+
+    // Bus statistics, cleared by resetStats()
+    unsigned long transactions;                     // address phases: writes and reads
+    unsigned long bytes;                            // bytes on the wire, addresses included
+    unsigned long busyMicros;                       // time the bus was busy
+    void resetStats(void)                       { transactions = 0; bytes = 0; busyMicros = 0; }
+
+    byte present;                                   // bit per device that ACKs, all by default
+
+private:
+    void transfer(unsigned int n);
+
+    cpShimMCP23017 devices[Devices];
+    uint32_t clock;
+    int  tx_address;
+    bool tx_havePointer;
+    byte tx_len;                                    // bytes written since beginTransmission()
+    byte pointer[Devices];                          // register pointer of each device
+    byte rx[32];
+    byte rx_len;
+    byte rx_pos;
+};
+
+extern TwoWire Wire;
@@ -0,0 +1,130 @@
+//==================================================================================
+//
+//  bus.cpp - Simulated RS485 CMRI bus, see bus.h
+//
+//==================================================================================
+
+#include "bus.h"
+
+BusPort::BusPort(Bus &bus) : txDone(0), rxStart(0), bus(bus) {
+}
+
+int BusPort::read(void) {
+    if (rx.empty()) {
+        return -1;
+    }
+    byte c = rx.front().c;
+    rxStart = rx.front().start;
+    rx.pop_front();
+    return c;
+}
+
+size_t BusPort::write(uint8_t c) {
+    bus.send(this, c);
+    return 1;
+}
+
+size_t BusPort::write(const uint8_t *buf, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        bus.send(this, buf[i]);
+    }
+    return n;
+}
+
+// Room left in the UART's transmit buffer
+int BusPort::availableForWrite(void) {
+    if (txDone <= bus.now) {
+        return UARTBuffer;
+    }
+    int queued = (int)((txDone - bus.now + bus.byteTime() - 1) / bus.byteTime());
+    return (queued < UARTBuffer) ? UARTBuffer - queued : 0;
+}
+
+
+Bus::Bus(unsigned long baud, bool fourWire) {
+    byte_ns = 10ULL * 1000000000ULL / baud;
+    four_wire = fourWire;
+    host = NULL;
+    now = 0;
+    busy[0] = busy[1] = 0;
+    bytes[0] = bytes[1] = 0;
+    collisions = 0;
+}
+
+// ----------------------------------------------------------------------
+//  Put a byte on the wire after whatever the sender's UART is already
+//  sending, and garble it, and anything it overlaps, if someone else is
+//  sending on the same pair at the time
+// ----------------------------------------------------------------------
+void Bus::send(BusPort *from, byte c) {
+    int p = pair(from);
+    Byte b;
+
+    b.start = (from->txDone > now) ? from->txDone : now;
+    b.end = b.start + byte_ns;
+    b.c = c;
+    b.garbled = false;
+    b.from = from;
+    from->txDone = b.end;
+
+    for (std::deque<Byte>::iterator i = wire[p].begin(); i != wire[p].end(); ++i) {
+        if ((i->from != from) && (i->end > b.start) && (i->start < b.end)) {
+            if (!i->garbled) {
+                collisions++;
+            }
+            i->garbled = true;
+            b.garbled = true;
+        }
+    }
+    if (b.garbled) {
+        collisions++;
+    }
+    wire[p].push_back(b);
+    busy[p] += byte_ns;
+    bytes[p]++;
+}
+
+ns_t Bus::nextDelivery(void) {
+    ns_t t = NEVER;
+    for (int p = 0; p < 2; p++) {
+        for (std::deque<Byte>::iterator i = wire[p].begin(); i != wire[p].end(); ++i) {
+            if (i->end < t) {
+                t = i->end;
+            }
+        }
+    }
+    return t;
+}
+
+void Bus::deliver(void) {
+    for (int p = 0; p < 2; p++) {
+        for (;;) {
+            std::deque<Byte>::iterator first = wire[p].end();
+            for (std::deque<Byte>::iterator i = wire[p].begin(); i != wire[p].end(); ++i) {
+                if ((i->end <= now) && ((first == wire[p].end()) || (i->end < first->end))) {
+                    first = i;
+                }
+            }
+            if (first == wire[p].end()) {
+                break;
+            }
+
+            BusPort::Rx r;
+            r.c = first->garbled ? (first->c ^ 0xA5) : first->c;
+            r.start = first->start;
+            std::vector<BusPort *> to;
+            if ((p == 1) || !four_wire) {
+                to.push_back(host);
+            }
+            if ((p == 0) || !four_wire) {
+                to.insert(to.end(), nodes.begin(), nodes.end());
+            }
+            for (size_t i = 0; i < to.size(); i++) {
+                if ((to[i]) && (to[i] != first->from)) {
+                    to[i]->rx.push_back(r);
+                }
+            }
+            wire[p].erase(first);
+        }
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+/*
+    ==================================================================================
+                  bus.h                 Simulated RS485 CMRI bus
+    ==================================================================================
+
+    Every byte takes 10 bit times (start, 8 data, stop) on the wire, and a
+    port's UART sends the bytes written to it back to back.  A byte reaches
+    the receivers when its stop bit is done.
+
+    On a 4 wire bus (the usual cpNode wiring) the host talks to the nodes on
+    one pair and the nodes answer on the other, so nodes only hear the host.
+    On a 2 wire bus everybody hears everybody else.  Bytes from two senders
+    that overlap on the same pair are garbled for every receiver.
+
+    Time is kept in nanoseconds; cpShim's micros() clock follows it.
+*/
+
+#include <Arduino.h>
+#include <deque>
+#include <vector>
+
+typedef unsigned long long ns_t;
+static const ns_t NEVER = ~0ULL;
+
+class Bus;
+
+class BusPort : public Stream {
+public:
+    BusPort(Bus &bus);
+
+    int available(void)                         { return (int)rx.size(); }
+    int read(void);
+    int peek(void)                              { return rx.empty() ? -1 : rx.front().c; }
+
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buf, size_t n);
+    int availableForWrite(void);
+
+    ns_t txDone;                                    // when the UART will have sent all it was given
+    ns_t rxStart;                                   // when the byte last read started arriving
+
+private:
+    friend class Bus;
+    static const int UARTBuffer = 64;
+
+    struct Rx {
+        byte c;
+        ns_t start;
+    };
+
+    Bus &bus;
+    std::deque<Rx> rx;
+};
+
+class Bus {
+public:
+    Bus(unsigned long baud, bool fourWire);
+
+    void attachHost(BusPort *p)                 { host = p; }
+    void attachNode(BusPort *p)                 { nodes.push_back(p); }
+
+    ns_t now;                                       // simulated time
+    void setTime(ns_t t)                        { now = t; cpShim::now_us = t / 1000; }
+
+    ns_t byteTime(void)                         { return byte_ns; }
+    ns_t nextDelivery(void);                        // when the next byte finishes, NEVER if none
+    void deliver(void);                             // hand over the bytes finished by now
+
+    // Statistics
+    ns_t busy[2];                                   // time each pair carried data: host to nodes, nodes to host
+    unsigned long bytes[2];
+    unsigned long collisions;                       // bytes garbled by another sender
+
+private:
+    friend class BusPort;
+    struct Byte {
+        ns_t start;
+        ns_t end;
+        byte c;
+        bool garbled;
+        BusPort *from;
+    };
+
+    void send(BusPort *from, byte c);
+    int pair(BusPort *from)                     { return (four_wire && (from != host)) ? 1 : 0; }
+
+    ns_t byte_ns;
+    bool four_wire;
+    BusPort *host;
+    std::vector<BusPort *> nodes;
+    std::deque<Byte> wire[2];                       // bytes on each pair, not yet received
+};
@@ -0,0 +1,561 @@
+//==================================================================================
+//
+//  bussim - Many cpNodes on one simulated RS485 bus, polled like JMRI does
+//
+//  The host sends each node an Init message, then scans the bus without a
+//  break.  The first scan sets every node's outputs and isn't counted;
+//  after that, for each node in turn, a T message if the host changed any of its
+//  outputs, then a P message, and waits for the node's R (or C) response or
+//  for the response timeout.  The nodes are the real library, each running
+//  proceess() every node loop period on the shared simulated clock, so the
+//  parser, the poll response pacing (DL) and change of state reporting are
+//  all the library's own.
+//
+//  Inputs wired to each node change at random between polls, and the host
+//  changes outputs at random; every response and every T message is
+//  checked against what the node actually had or got.
+//
+//==================================================================================
+
+#include "bus.h"
+#include <cpNode.h>
+#include <getopt.h>
+
+struct Config {
+    int nodes;
+    unsigned long baud;
+    bool fourWire;
+    unsigned int dl;                    // delay between response bytes, microseconds (Init DL x 10)
+    byte ib;                            // input bytes per node
+    byte ob;                            // output bytes per node
+    unsigned long loopUs;               // time around each node's loop(), +/- 25%
+    int scans;
+    int inChange;                       // % chance a node's inputs changed since its last poll
+    int outChange;                      // % chance the host changes a node's outputs per scan
+    bool changes;                       // nodes answer with C messages
+    unsigned long timeoutUs;            // host response timeout
+    double targetMs;                    // scan cycle target, 0 = none
+    bool perNode;
+    bool sweep;
+    unsigned long seed;
+
+    Config(void) : nodes(64), baud(115200), fourWire(true), dl(0), ib(3), ob(6),
+                   loopUs(100), scans(100), inChange(10), outChange(10), changes(false),
+                   timeoutUs(50000), targetMs(0), perNode(false), sweep(false), seed(1) { }
+};
+
+static unsigned long rnd = 1;
+
+static unsigned long random32(void) {
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 17;
+    rnd ^= rnd << 5;
+    return rnd & 0xFFFFFFFFUL;
+}
+
+// --------------------------------------------------------------------------
+//  One node on the bus, and what the host knows about it
+// --------------------------------------------------------------------------
+struct SimNode {
+    explicit SimNode(Bus &bus) : port(bus) { }
+
+    cpNode node;
+    BusPort port;
+    cpNodeStats stats;
+    ns_t nextLoop;
+
+    byte in[cpNode::IO_bufsize];        // levels on the node's inputs
+    byte out[cpNode::IO_bufsize];       // outputs as last unpacked by the node
+    byte hostIn[cpNode::IO_bufsize];    // inputs as last reported to the host
+    byte hostOut[cpNode::IO_bufsize];   // outputs as the host set them
+
+    unsigned long polls;
+    unsigned long timeouts;
+    unsigned long bad;                  // responses that didn't parse or check out
+    unsigned long r, c;                 // R and C responses
+    ns_t latMin, latMax, latSum;        // end of poll to start of response
+
+    void clearStats(void) {
+        polls = timeouts = bad = r = c = 0;
+        latMin = NEVER;
+        latMax = latSum = 0;
+    }
+};
+
+// pack() and unpack() have no node argument, so the node being run is kept here
+static SimNode *current;
+
+static void simPack(byte *IB, int len) {
+    memcpy(IB, current->in, len);
+}
+
+static void simUnpack(byte *OB, int len) {
+    memcpy(current->out, OB, len);
+}
+
+extern "C" {
+    void pack(  byte *IB, int len)  { simPack(IB, len); }
+    void unpack(byte *OB, int len)  { simUnpack(OB, len); }
+}
+
+
+// --------------------------------------------------------------------------
+//  The host
+// --------------------------------------------------------------------------
+class Host {
+public:
+    Host(Bus &bus, std::vector<SimNode *> &nodes, const Config &cfg);
+
+    void start(void);                   // send the Init messages
+    void step(void);                    // do whatever is due by bus.now
+    ns_t nextEvent(void)                { return (state == SEND) ? readyAt : deadline; }
+
+    BusPort port;
+    int scans;                          // completed scans, not counting the first
+    ns_t scanSum, scanMax, scanMin;
+    ns_t started;                       // start of the first scan
+    unsigned long bytesSent;
+    unsigned long bytesAtStart[2];      // host, nodes
+    unsigned long outputErrors;         // T messages that the node got wrong
+
+private:
+    enum { SEND, WAIT };
+    enum { H_HUNT, H_SYN, H_UA, H_TYPE, H_DATA, H_DLE };
+
+    void sendFrame(byte ua, char type, const byte *data, int len);
+    void poll(void);
+    void receive(byte c);
+    void response(void);
+    void next(void);
+
+    Bus &bus;
+    std::vector<SimNode *> &nodes;
+    const Config &cfg;
+
+    int state;
+    int cur;                            // node being polled
+    ns_t readyAt;                       // when the next poll can go out
+    ns_t pollEnd;                       // when the poll's ETX reached the nodes
+    ns_t deadline;                      // response timeout
+    ns_t respStart;                     // first byte of the frame being received
+    ns_t scanStart;
+
+    int rx_state;
+    byte rx_ua;
+    byte rx_type;
+    byte rx_data[2 * cpNode::IO_bufsize];
+    int  rx_len;
+};
+
+Host::Host(Bus &bus, std::vector<SimNode *> &nodes, const Config &cfg)
+    : port(bus), bus(bus), nodes(nodes), cfg(cfg) {
+    scans = -1;
+    scanSum = scanMax = 0;
+    scanMin = NEVER;
+    started = 0;
+    outputErrors = 0;
+    bytesSent = 0;
+    state = SEND;
+    cur = 0;
+    readyAt = 0;
+    pollEnd = deadline = respStart = scanStart = 0;
+    rx_state = H_HUNT;
+    rx_len = 0;
+}
+
+void Host::sendFrame(byte ua, char type, const byte *data, int len) {
+    byte f[5 + 2 * cpNode::IO_bufsize + 10 + 1];
+    int n = 0;
+
+    f[n++] = 0xFF;
+    f[n++] = 0xFF;
+    f[n++] = 0x02;
+    f[n++] = 'A' + ua;
+    f[n++] = type;
+    for (int i = 0; i < len; i++) {
+        if ((data[i] == 0x02) || (data[i] == 0x03) || (data[i] == 0x10)) {
+            f[n++] = 0x10;
+        }
+        f[n++] = data[i];
+    }
+    f[n++] = 0x03;
+    port.write(f, n);
+    bytesSent += n;
+}
+
+// cpNode Init: NDP, DL high, DL low, opts1, opts2, input bytes, output bytes
+void Host::start(void) {
+    byte init[7] = { 'C', (byte)((cfg.dl / 10) >> 8), (byte)(cfg.dl / 10), 0, 0, cfg.ib, cfg.ob };
+
+    for (size_t i = 0; i < nodes.size(); i++) {
+        sendFrame(i, 'I', init, sizeof(init));
+    }
+    readyAt = port.txDone + 2 * cfg.loopUs * 1000;
+}
+
+void Host::poll(void) {
+    SimNode *n = nodes[cur];
+
+    if (cur == 0) {
+        scanStart = bus.now;
+        if (scans == 0) {
+            started = bus.now;
+            bytesAtStart[0] = bytesSent;
+            bytesAtStart[1] = bus.bytes[0] + bus.bytes[1] - bytesSent;
+            for (size_t i = 0; i < nodes.size(); i++) {
+                nodes[i]->clearStats();
+                nodes[i]->stats.reset();
+            }
+        }
+    }
+
+    // The world moves on: inputs change, the host sets outputs
+    if ((int)(random32() % 100) < cfg.inChange) {
+        n->in[random32() % cfg.ib] ^= 1 << (random32() % 8);
+    }
+    if ((scans < 0) || ((int)(random32() % 100) < cfg.outChange)) {
+        if (scans >= 0) {
+            n->hostOut[random32() % cfg.ob] ^= 1 << (random32() % 8);
+        }
+        sendFrame(cur, 'T', n->hostOut, cfg.ob);
+    }
+
+    sendFrame(cur, 'P', NULL, 0);
+    n->polls++;
+    pollEnd = port.txDone;
+    deadline = pollEnd + cfg.timeoutUs * 1000ULL;
+    respStart = 0;
+    rx_state = H_HUNT;
+    state = WAIT;
+}
+
+void Host::receive(byte c) {
+    switch (rx_state) {
+    case H_HUNT:    if (c == 0xFF) {
+                        respStart = port.rxStart;
+                        rx_state = H_SYN;
+                    }
+                    break;
+    case H_SYN:     if (c == 0x02) rx_state = H_UA;
+                    else if (c != 0xFF) rx_state = H_HUNT;
+                    break;
+    case H_UA:      rx_ua = c - 'A';
+                    rx_state = H_TYPE;
+                    break;
+    case H_TYPE:    rx_type = c;
+                    rx_len = 0;
+                    rx_state = H_DATA;
+                    break;
+    case H_DATA:    if (c == 0x03) {
+                        rx_state = H_HUNT;
+                        response();
+                    } else if (c == 0x10) {
+                        rx_state = H_DLE;
+                    } else if (rx_len < (int)sizeof(rx_data)) {
+                        rx_data[rx_len++] = c;
+                    }
+                    break;
+    case H_DLE:     if (rx_len < (int)sizeof(rx_data)) {
+                        rx_data[rx_len++] = c;
+                    }
+                    rx_state = H_DATA;
+                    break;
+    }
+}
+
+// ----------------------------------------------------------------------
+//  A whole response: check it, and against what the node's inputs are
+// ----------------------------------------------------------------------
+void Host::response(void) {
+    SimNode *n = nodes[cur];
+    bool ok = false;
+
+    if ((state != WAIT) || (rx_ua != cur) || (respStart < pollEnd)) {
+        if (rx_ua < nodes.size()) {
+            nodes[rx_ua]->bad++;                // too late, or garbled
+        }
+        return;
+    }
+
+    if ((rx_type == 'R') && (rx_len == cfg.ib)) {
+        memcpy(n->hostIn, rx_data, cfg.ib);
+        n->r++;
+        ok = true;
+    } else if (rx_type == 'C') {
+        int nmap = (cfg.ib + 7) / 8;
+        int k = nmap;
+        ok = true;
+        if (rx_len > 0) {
+            for (int i = 0; ok && (i < cfg.ib); i++) {
+                if (rx_data[i >> 3] & (1 << (i & 7))) {
+                    ok = (k < rx_len);
+                    if (ok) {
+                        n->hostIn[i] = rx_data[k++];
+                    }
+                }
+            }
+            ok = ok && (k == rx_len);
+        }
+        n->c++;
+    }
+    if (ok) {
+        ok = (memcmp(n->hostIn, n->in, cfg.ib) == 0);
+    }
+    if (!ok) {
+        n->bad++;
+    }
+
+    ns_t lat = respStart - pollEnd;
+    n->latSum += lat;
+    if (lat < n->latMin) n->latMin = lat;
+    if (lat > n->latMax) n->latMax = lat;
+    next();
+}
+
+void Host::next(void) {
+    if (memcmp(nodes[cur]->out, nodes[cur]->hostOut, cfg.ob) != 0) {
+        outputErrors++;
+        memcpy(nodes[cur]->out, nodes[cur]->hostOut, cfg.ob);     // count it once
+    }
+    if (++cur >= (int)nodes.size()) {
+        ns_t t = bus.now - scanStart;
+        if (scans >= 0) {
+            scanSum += t;
+            if (t > scanMax) scanMax = t;
+            if (t < scanMin) scanMin = t;
+        }
+        scans++;
+        cur = 0;
+    }
+    state = SEND;
+    readyAt = bus.now;
+}
+
+void Host::step(void) {
+    while (port.available() > 0) {
+        receive(port.read());
+    }
+    if ((state == WAIT) && (bus.now >= deadline)) {
+        nodes[cur]->timeouts++;
+        next();
+    }
+    if ((state == SEND) && (bus.now >= readyAt) && (scans < cfg.scans)) {
+        poll();
+    }
+}
+
+
+// --------------------------------------------------------------------------
+//  Run one bus
+// --------------------------------------------------------------------------
+struct Result {
+    double scanAvgMs, scanMinMs, scanMaxMs;
+    double hostBytesPerScan, nodeBytesPerScan;
+    double hostUtil, nodeUtil;
+    double latAvgUs, latMaxUs;
+    unsigned long polls, timeouts, bad, r, c, collisions, outputErrors, nodeErrors;
+};
+
+static Result run(const Config &cfg, bool print) {
+    Bus bus(cfg.baud, cfg.fourWire);
+    std::vector<SimNode *> nodes;
+    Result res;
+
+    rnd = cfg.seed;
+    for (int i = 0; i < cfg.nodes; i++) {
+        SimNode *n = new SimNode(bus);
+        n->node.setCMRIPort(&n->port);
+        n->node.setNodeAddress(i);
+        n->node.setNumInputBytes(cfg.ib);
+        n->node.setNumOutputBytes(cfg.ob);
+        n->node.setPackHandler(simPack);
+        n->node.setUnpackHandler(simUnpack);
+        n->node.setStats(&n->stats);
+        if (cfg.changes) {
+            n->node.setReportChanges(true);
+        }
+        for (int b = 0; b < cpNode::IO_bufsize; b++) {
+            n->in[b] = random32();
+            n->out[b] = n->hostIn[b] = n->hostOut[b] = 0;
+        }
+        n->nextLoop = (ns_t)cfg.loopUs * 1000 * i / cfg.nodes;     // not all in step
+        n->clearStats();
+        bus.attachNode(&n->port);
+        nodes.push_back(n);
+    }
+
+    Host host(bus, nodes, cfg);
+    bus.attachHost(&host.port);
+    bus.setTime(0);
+    host.start();
+
+    while (host.scans < cfg.scans) {
+        ns_t t = bus.nextDelivery();
+        if (host.nextEvent() < t) {
+            t = host.nextEvent();
+        }
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (nodes[i]->nextLoop < t) {
+                t = nodes[i]->nextLoop;
+            }
+        }
+        if (t < bus.now) {
+            t = bus.now;
+        }
+
+        bus.setTime(t);
+        bus.deliver();
+        host.step();
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (nodes[i]->nextLoop <= t) {
+                current = nodes[i];
+                current->node.proceess();
+                current->nextLoop += cfg.loopUs * (750ULL + random32() % 501);
+            }
+        }
+    }
+
+    ns_t total = bus.now - host.started;
+    memset(&res, 0, sizeof(res));
+    res.scanAvgMs = host.scanSum / 1e6 / host.scans;
+    res.scanMinMs = host.scanMin / 1e6;
+    res.scanMaxMs = host.scanMax / 1e6;
+    res.hostBytesPerScan = (double)(host.bytesSent - host.bytesAtStart[0]) / host.scans;
+    res.nodeBytesPerScan = (double)(bus.bytes[0] + bus.bytes[1] - host.bytesSent
+                                    - host.bytesAtStart[1]) / host.scans;
+    res.hostUtil = 100.0 * res.hostBytesPerScan * host.scans * bus.byteTime() / total;
+    res.nodeUtil = 100.0 * res.nodeBytesPerScan * host.scans * bus.byteTime() / total;
+    res.collisions = bus.collisions;
+    res.outputErrors = host.outputErrors;
+
+    ns_t latSum = 0, latMax = 0;
+    unsigned long answered = 0;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        SimNode *n = nodes[i];
+        res.polls += n->polls;
+        res.timeouts += n->timeouts;
+        res.bad += n->bad;
+        res.r += n->r;
+        res.c += n->c;
+        res.nodeErrors += n->stats.getCount(cpNodeStats::COUNT_BAD_TYPE)
+                        + n->stats.getCount(cpNodeStats::COUNT_OVERRUN)
+                        + n->stats.getCount(cpNodeStats::COUNT_RESYNC);
+        latSum += n->latSum;
+        answered += n->r + n->c;
+        if (n->latMax > latMax) latMax = n->latMax;
+    }
+    res.latAvgUs = answered ? latSum / 1e3 / answered : 0;
+    res.latMaxUs = latMax / 1e3;
+
+    if (print && cfg.perNode) {
+        printf("\n  node   polls     R     C  timeouts  bad   latency us: min     avg     max\n");
+        for (size_t i = 0; i < nodes.size(); i++) {
+            SimNode *n = nodes[i];
+            unsigned long a = n->r + n->c;
+            printf("  %4u %7lu %5lu %5lu %9lu %4lu   %18.1f %7.1f %7.1f\n", (unsigned)i,
+                   n->polls, n->r, n->c, n->timeouts, n->bad,
+                   a ? n->latMin / 1e3 : 0.0, a ? n->latSum / 1e3 / a : 0.0, n->latMax / 1e3);
+        }
+    }
+    for (size_t i = 0; i < nodes.size(); i++) {
+        delete nodes[i];
+    }
+    return res;
+}
+
+static void usage(void) {
+    printf("usage: bussim [options]\n"
+           "  -n nodes      nodes on the bus (64)\n"
+           "  -b baud       bus speed (115200)\n"
+           "  -2            2 wire bus, everybody hears everybody (default 4 wire)\n"
+           "  -d us         delay between response bytes (DL), microseconds (0)\n"
+           "  -i bytes      input bytes per node (3)\n"
+           "  -o bytes      output bytes per node (6)\n"
+           "  -l us         node loop() period, varies +/- 25%% (100)\n"
+           "  -s scans      scans to run (100)\n"
+           "  -I percent    chance a node's inputs changed between polls (10)\n"
+           "  -O percent    chance per scan the host changes a node's outputs (10)\n"
+           "  -c            nodes report changes with C messages\n"
+           "  -t ms         host response timeout (50)\n"
+           "  -T ms         scan cycle target, to check against\n"
+           "  -r seed       random seed (1)\n"
+           "  -v            per node results\n"
+           "  -S            sweep: 8, 16 ... up to -n nodes, one line each\n");
+}
+
+int main(int argc, char **argv) {
+    Config cfg;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:b:2d:i:o:l:s:I:O:ct:T:r:vSh")) != -1) {
+        switch (opt) {
+        case 'n':   cfg.nodes = atoi(optarg);                   break;
+        case 'b':   cfg.baud = strtoul(optarg, NULL, 10);       break;
+        case '2':   cfg.fourWire = false;                       break;
+        case 'd':   cfg.dl = atoi(optarg);                      break;
+        case 'i':   cfg.ib = atoi(optarg);                      break;
+        case 'o':   cfg.ob = atoi(optarg);                      break;
+        case 'l':   cfg.loopUs = strtoul(optarg, NULL, 10);     break;
+        case 's':   cfg.scans = atoi(optarg);                   break;
+        case 'I':   cfg.inChange = atoi(optarg);                break;
+        case 'O':   cfg.outChange = atoi(optarg);               break;
+        case 'c':   cfg.changes = true;                         break;
+        case 't':   cfg.timeoutUs = strtoul(optarg, NULL, 10) * 1000;  break;
+        case 'T':   cfg.targetMs = atof(optarg);                break;
+        case 'r':   cfg.seed = strtoul(optarg, NULL, 10);       break;
+        case 'v':   cfg.perNode = true;                         break;
+        case 'S':   cfg.sweep = true;                           break;
+        default:    usage();                                    return 1;
+        }
+    }
+    if ((cfg.nodes < 1) || (cfg.nodes > 64) || (cfg.ib < 1) || (cfg.ib > cpNode::IO_bufsize) ||
+        (cfg.ob < 1) || (cfg.ob > cpNode::IO_bufsize) || (cfg.baud == 0) || (cfg.loopUs == 0) ||
+        (cfg.scans < 1) || (cfg.seed == 0)) {
+        usage();
+        return 1;
+    }
+
+    printf("%d nodes, %lu baud, %s, DL %uus, %d in / %d out bytes, %s, node loop %luus\n",
+           cfg.nodes, cfg.baud, cfg.fourWire ? "4 wire" : "2 wire", cfg.dl, cfg.ib, cfg.ob,
+           cfg.changes ? "C messages" : "R messages", cfg.loopUs);
+    printf("inputs change %d%%, outputs change %d%% of polls, %d scans\n",
+           cfg.inChange, cfg.outChange, cfg.scans);
+
+    if (cfg.sweep) {
+        int last = cfg.nodes;
+        printf("\n  nodes  scan ms: avg     max   bytes/scan  host->  <-nodes  latency us  errors\n");
+        for (int n = 8; ; n += 8) {
+            cfg.nodes = (n < last) ? n : last;
+            Result r = run(cfg, false);
+            printf("  %5d  %12.2f %7.2f  %11.0f  %5.1f%%  %6.1f%%  %10.1f  %6lu%s\n", cfg.nodes,
+                   r.scanAvgMs, r.scanMaxMs, r.hostBytesPerScan + r.nodeBytesPerScan,
+                   r.hostUtil, r.nodeUtil, r.latAvgUs,
+                   r.timeouts + r.bad + r.collisions + r.outputErrors + r.nodeErrors,
+                   ((cfg.targetMs > 0) && (r.scanMaxMs > cfg.targetMs)) ? "  over target" : "");
+            if (cfg.nodes >= last) {
+                break;
+            }
+        }
+        return 0;
+    }
+
+    Result r = run(cfg, true);
+    printf("\n");
+    printf("  scan cycle         %8.2f ms avg, %.2f min, %.2f max", r.scanAvgMs, r.scanMinMs, r.scanMaxMs);
+    if (cfg.targetMs > 0) {
+        printf("  (target %.2f ms: %s)", cfg.targetMs, (r.scanMaxMs <= cfg.targetMs) ? "met" : "MISSED");
+    }
+    printf("\n");
+    printf("  bytes per scan     %8.0f host to nodes, %.0f nodes to host\n", r.hostBytesPerScan, r.nodeBytesPerScan);
+    if (cfg.fourWire) {
+        printf("  bus utilisation    %8.1f %% host to nodes, %.1f %% nodes to host\n", r.hostUtil, r.nodeUtil);
+    } else {
+        printf("  bus utilisation    %8.1f %%\n", r.hostUtil + r.nodeUtil);
+    }
+    printf("  response latency   %8.1f us avg, %.1f max (end of poll to start of response)\n", r.latAvgUs, r.latMaxUs);
+    printf("  responses          %8lu R, %lu C, of %lu polls\n", r.r, r.c, r.polls);
+    printf("  errors             %8lu timeouts, %lu bad responses, %lu outputs wrong,\n"
+           "                     %8lu garbled bytes, %lu node framing errors\n",
+           r.timeouts, r.bad, r.outputErrors, r.collisions, r.nodeErrors);
+    return 0;
+}
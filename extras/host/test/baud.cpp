@@ -0,0 +1,147 @@
+//==================================================================================
+//
+//  Link speed tests: the host changing the speed, and falling back or
+//  hunting for it when no message turns up
+//
+//  The port is not really reopened: the handler just logs each speed the
+//  node asks for, and messages "arrive" at whatever speed is current.
+//
+//==================================================================================
+
+#include "test.h"
+
+using namespace test;
+
+static const uint64_t MillisWrap = (1ULL << 32) * 1000;     // now_us when millis() wraps
+
+static const unsigned long Speeds[] = {                     // Init baud codes 1..7, as documented
+    9600, 19200, 28800, 38400, 57600, 115200, 230400
+};
+static const unsigned Codes = sizeof(Speeds) / sizeof(Speeds[0]);
+
+static std::vector<unsigned long> rates;                    // each speed the node set
+
+static void logBaud(unsigned long baud) {
+    rates.push_back(baud);
+}
+
+static void setupNode(cpNode &node, MemStream &port, uint64_t now) {
+    cpShim::now_us = now;
+    node.setCMRIPort(&port);
+    node.setNodeAddress(0);
+    node.setNumInputBytes(1);
+    node.setBaudHandler(logBaud, 19200, 2000);
+    rates.clear();
+}
+
+// A cpNode Init message carrying baud code <code> in opts2
+static std::vector<byte> init(byte code) {
+    byte data[7] = { 'C', 0, 0, 0, code, 0, 0 };
+    return frame(0, 'I', data, sizeof(data));
+}
+
+// <ms> of proceess(), a millisecond at a time
+static void runFor(cpNode &node, int ms) {
+    for (int i = 0; i < ms; i++) {
+        cpShim::advance(1000);
+        node.proceess();
+    }
+}
+
+// ----------------------------------------------------------------------
+//  An Init with a baud code moves the link to that speed, and a message
+//  at the new speed keeps it there past the timeout
+// ----------------------------------------------------------------------
+static void hostChange(void) {
+    cpNode node;
+    MemStream port;
+
+    setupNode(node, port, 0);
+    port.feed(init(6));                     // 115200
+    drain(node, port);
+    CHECK((rates.size() == 1) && (rates[0] == 115200));
+    CHECK((node.getBaud() == 115200) && !node.isBaudLocked());
+
+    runFor(node, 500);
+    port.feed(frame(0, 'P'));
+    drain(node, port);
+    CHECK(node.isBaudLocked());
+    runFor(node, 3000);
+    CHECK((rates.size() == 1) && (node.getBaud() == 115200));
+}
+
+// ----------------------------------------------------------------------
+//  A baud code of 0, or past the end of the speeds, leaves the speed
+//  alone, as does the code for the speed already in use
+// ----------------------------------------------------------------------
+static void invalidCode(void) {
+    cpNode node;
+    MemStream port;
+
+    setupNode(node, port, 0);
+    port.feed(init(0));
+    port.feed(init(Codes + 1));
+    port.feed(init(0xFF));
+    port.feed(init(2));                     // 19200, as now
+    drain(node, port);
+    runFor(node, 3000);
+    CHECK(rates.empty());
+    CHECK((node.getBaud() == 19200) && node.isBaudLocked());
+}
+
+// ----------------------------------------------------------------------
+//  With nothing heard at the new speed, the node goes back to the old
+//  one after the full timeout, across a millis() wrap
+// ----------------------------------------------------------------------
+static void fallback(void) {
+    cpNode node;
+    MemStream port;
+    uint64_t start;
+
+    setupNode(node, port, MillisWrap - 1000000);
+    port.feed(init(5));                     // 57600
+    drain(node, port);
+    start = cpShim::now_us;
+    CHECK((rates.size() == 1) && (rates[0] == 57600));
+
+    while ((rates.size() == 1) && (cpShim::now_us < start + 5000000)) {
+        runFor(node, 1);
+    }
+    CHECK((rates.size() == 2) && (rates[1] == 19200));
+    CHECK(cpShim::now_us - start >= 2000000);
+    CHECK(cpShim::now_us - start <= 2002000);
+    CHECK((node.getBaud() == 19200) && node.isBaudLocked());
+}
+
+// ----------------------------------------------------------------------
+//  autoBaud() starts at the current speed and tries each of the speeds
+//  for the timeout in turn, round to the start again, until a message
+//  shows up
+// ----------------------------------------------------------------------
+static void hunt(void) {
+    cpNode node;
+    MemStream port;
+    unsigned r;
+
+    setupNode(node, port, 0);
+    node.autoBaud();
+    CHECK(!node.isBaudLocked());
+    runFor(node, 2000 * (Codes + 1) + 500);     // round once, and on to the third
+    CHECK(rates.size() == Codes + 2);
+    for (r = 0; r < rates.size(); r++) {
+        CHECK(rates[r] == Speeds[(1 + r) % Codes]);
+    }
+
+    port.feed(frame(3, 'P'));               // any node's message will do
+    drain(node, port);
+    CHECK(node.isBaudLocked());
+    runFor(node, 5000);
+    CHECK((rates.size() == Codes + 2) && (node.getBaud() == Speeds[2]));
+}
+
+void testBaud(void) {
+    hostChange();
+    invalidCode();
+    fallback();
+    hunt();
+}
@@ -0,0 +1,186 @@
+//==================================================================================
+//
+//  Clock tests: the library's timing across a micros() or millis() wrap
+//
+//  Each case starts the simulated clock a little before micros() or
+//  millis() wraps around at 32 bits, and checks that the timing it
+//  depends on is the same on both sides of the wrap.
+//
+//==================================================================================
+
+#include "test.h"
+
+using namespace test;
+
+static const uint64_t MicrosWrap = 1ULL << 32;              // now_us when micros() wraps
+static const uint64_t MillisWrap = (1ULL << 32) * 1000;     //   ... and millis()
+
+static byte outputs;
+static std::vector<uint64_t> times;                         // cpShim::now_us at each call
+
+static void unpackLog(byte *OB, int) {
+    if ((times.empty()) || (OB[0] != outputs)) {
+        times.push_back(cpShim::now_us);
+    }
+    outputs = OB[0];
+}
+
+static void packLog(byte *IB, int) {
+    IB[0] = 0;
+    times.push_back(cpShim::now_us);
+}
+
+// Smallest gap between successive times[]
+static uint64_t shortest(void) {
+    uint64_t gap = ~0ULL;
+    for (size_t i = 1; i < times.size(); i++) {
+        if (times[i] - times[i - 1] < gap) {
+            gap = times[i] - times[i - 1];
+        }
+    }
+    return gap;
+}
+
+// ----------------------------------------------------------------------
+//  A message that straddles the wrap is not mistaken for one that
+//  stalled past the inter-byte timeout
+// ----------------------------------------------------------------------
+static void rxTimeout(void) {
+    cpNode node;
+    MemStream port;
+    byte data[2] = { 0x5A, 0xA5 };
+    std::vector<byte> t = frame(0, 'T', data, sizeof(data));
+
+    cpShim::now_us = MicrosWrap - 100;
+    node.setCMRIPort(&port);
+    node.setNodeAddress(0);
+    node.setNumOutputBytes(2);
+    node.setUnpackHandler(unpackLog);
+    node.setRXTimeout(1000);
+    times.clear();
+    outputs = 0;
+
+    port.feed(&t[0], 5);                    // up to the message type
+    node.proceess();
+    cpShim::advance(200);                   // past the wrap, well inside the timeout
+    node.proceess();
+    port.feed(&t[5], t.size() - 5);
+    drain(node, port);
+    CHECK(outputs == 0x5A);
+}
+
+// ----------------------------------------------------------------------
+//  DL pacing keeps the bytes of a response DL apart across the wrap
+// ----------------------------------------------------------------------
+static void txPacing(void) {
+    cpNode node;
+    MemStream port;
+    byte init[7] = { 'C', 0, 10, 0, 0, 0, 0 };     // DL = 10 x 10us
+    size_t sent = 0;
+
+    cpShim::now_us = MicrosWrap - 255;
+    node.setCMRIPort(&port);
+    node.setNodeAddress(0);
+    node.setNumInputBytes(4);
+    port.feed(frame(0, 'I', init, sizeof(init)));
+    drain(node, port);
+    port.feed(frame(0, 'P'));
+    times.clear();
+
+    for (int i = 0; i < 2000; i++) {
+        node.proceess();
+        if (port.sent.size() > sent) {
+            sent = port.sent.size();
+            times.push_back(cpShim::now_us);
+        }
+        cpShim::advance(10);
+    }
+    CHECK(sent == 5 + 4 + 1);               // SYN SYN STX UA R, 4 inputs, ETX
+    CHECK(shortest() >= 100);
+}
+
+// ----------------------------------------------------------------------
+//  Background input sampling keeps to its period across the wrap
+// ----------------------------------------------------------------------
+static void samplePeriod(void) {
+    cpNode node;
+    MemStream port;
+
+    cpShim::now_us = MicrosWrap - 2500;
+    node.setCMRIPort(&port);
+    node.setNodeAddress(0);
+    node.setNumInputBytes(1);
+    node.setPackHandler(packLog);
+    node.setInputSamplePeriod(1000);
+    times.clear();
+
+    for (int i = 0; i < 100; i++) {
+        node.proceess();
+        cpShim::advance(50);
+    }
+    CHECK(times.size() == 5);
+    CHECK(shortest() >= 1000);
+}
+
+// ----------------------------------------------------------------------
+//  A flasher keeps flashing across a millis() wrap
+// ----------------------------------------------------------------------
+static void flasher(void) {
+    cpNode node;
+    cpTimedOutputs timed;
+    MemStream port;
+    byte data[1] = { 0x01 };
+
+    cpShim::now_us = MillisWrap - 300000;
+    node.setCMRIPort(&port);
+    node.setNodeAddress(0);
+    node.setNumOutputBytes(1);
+    node.setUnpackHandler(unpackLog);
+    timed.setFlashRate(0, 100);
+    timed.setMode(0, 0x01, cpTimedOutputs::MODE_FLASH);
+    node.setTimedOutputs(&timed);
+    port.feed(frame(0, 'T', data, sizeof(data)));
+    drain(node, port);
+    times.clear();
+
+    for (int i = 0; i < 1000; i++) {        // 1s, 300ms before the wrap to 700ms after
+        cpShim::advance(1000);
+        node.proceess();
+    }
+    CHECK(times.size() == 10);
+    CHECK(shortest() >= 100000);
+}
+
+// ----------------------------------------------------------------------
+//  The hold timeout runs its full length across a millis() wrap
+// ----------------------------------------------------------------------
+static void holdTimeout(void) {
+    cpNode node;
+    cpTimedOutputs timed;
+    MemStream port;
+    byte data[1] = { 0x01 };
+
+    cpShim::now_us = MillisWrap - 500000;
+    node.setCMRIPort(&port);
+    node.setNodeAddress(0);
+    node.setNumOutputBytes(1);
+    timed.setMode(0, 0x01, cpTimedOutputs::MODE_SAFE_OFF);
+    timed.setHoldTimeout(1000);
+    node.setTimedOutputs(&timed);
+    port.feed(frame(0, 'T', data, sizeof(data)));
+    drain(node, port);
+    while (!timed.isFailsafe() && (cpShim::now_us < MillisWrap + 2000000)) {
+        cpShim::advance(1000);
+        node.proceess();
+    }
+    CHECK(cpShim::now_us >= MillisWrap + 500000);
+    CHECK(cpShim::now_us <= MillisWrap + 510000);
+}
+
+void testClock(void) {
+    rxTimeout();
+    txPacing();
+    samplePeriod();
+    flasher();
+    holdTimeout();
+}
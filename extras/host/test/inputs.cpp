@@ -0,0 +1,62 @@
+//==================================================================================
+//
+//  Input tests: debouncing
+//
+//==================================================================================
+
+#include "test.h"
+
+using namespace test;
+
+static byte level;
+
+static void packLevel(byte *IB, int) {
+    IB[0] = level;
+}
+
+// The input byte the node reports for a poll
+static int poll(cpNode &node, MemStream &port) {
+    port.clear();
+    port.feed(frame(0, 'P'));
+    drain(node, port);
+    return (port.sent.size() == 7) ? port.sent[5] : -1;
+}
+
+// <n> sample periods of proceess()
+static void samples(cpNode &node, int n) {
+    for (int i = 0; i < n * 10; i++) {
+        cpShim::advance(100);
+        node.proceess();
+    }
+}
+
+// ----------------------------------------------------------------------
+//  A mask set before setDebounce() is kept, and a 0 sample period is
+//  refused rather than quietly turning debouncing off
+// ----------------------------------------------------------------------
+static void debounceMask(void) {
+    cpNode node;
+    MemStream port;
+
+    cpShim::now_us = 0;
+    node.setCMRIPort(&port);
+    node.setNodeAddress(0);
+    node.setNumInputBytes(1);
+    node.setPackHandler(packLevel);
+    level = 0x00;
+
+    node.setDebounceMask(0, 0x01);          // bit 0 debounced, the rest passed through
+    CHECK(node.setDebounce(4, 1000));
+    CHECK(!node.setDebounce(4, 0));
+    samples(node, 2);
+
+    level = 0x81;
+    samples(node, 1);
+    CHECK(poll(node, port) == 0x80);        // bit 7 right away
+    samples(node, 4);
+    CHECK(poll(node, port) == 0x81);        // bit 0 once it has been seen 4 times
+}
+
+void testInputs(void) {
+    debounceMask();
+}
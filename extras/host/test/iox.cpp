@@ -0,0 +1,89 @@
+//==================================================================================
+//
+//  IOX tests: queued expander transactions, interrupt on change inputs
+//
+//==================================================================================
+
+#include "test.h"
+
+using namespace test;
+
+// ----------------------------------------------------------------------
+//  A write only merges into the newest queued write of the same
+//  registers, never past a later write to one of its ports: the mix
+//  IOXBank makes through update16() when one port or both changed
+// ----------------------------------------------------------------------
+static void queueMerge(void) {
+    IOXQueue q;
+    cpShimMCP23017 *dev = Wire.device(0x20);
+    byte both1[2] = { 0x11, 0x12 };
+    byte both2[2] = { 0x31, 0x32 };
+    byte both3[2] = { 0x51, 0x52 };
+
+    IOX::begin();
+    IOX::init16(0x20, IOX::OUT, IOX::OUT);
+
+    q.write16(0x20, both1);
+    q.write(0x20, IOX::PORT_A, 0x21);
+    q.write16(0x20, both2);
+    q.flush();
+    CHECK(dev->getOutputs(IOX::PORT_A) == 0x31);
+    CHECK(dev->getOutputs(IOX::PORT_B) == 0x32);
+    CHECK(q.getCompleted() == 3);
+
+    q.update16(0x20, both1, true, false);
+    q.update16(0x20, both2, true, true);
+    q.update16(0x20, both3, false, true);
+    q.flush();
+    CHECK(dev->getOutputs(IOX::PORT_A) == 0x31);
+    CHECK(dev->getOutputs(IOX::PORT_B) == 0x52);
+
+    // ... while back to back writes of the same registers still merge
+    q.write16(0x20, both1);
+    q.write(0x21, IOX::PORT_A, 0x21);       // another device in between
+    q.write16(0x20, both3);
+    q.flush();
+    CHECK(dev->getOutputs(IOX::PORT_A) == 0x51);
+    CHECK(dev->getOutputs(IOX::PORT_B) == 0x52);
+    CHECK(q.getCompleted() == 3 + 3 + 2);
+}
+
+// ----------------------------------------------------------------------
+//  A pulse that is over before the device is read is reported once,
+//  and readChanged() asks to be called again to pick up its end, which
+//  raises no interrupt of its own
+// ----------------------------------------------------------------------
+static void shortPulse(void) {
+    cpShimMCP23017 *dev = Wire.device(0x22);
+    byte data[2];
+    byte r;
+
+    IOX::begin();
+    dev->setInputs(IOX::PORT_A, 0xFF);      // nothing pulled low (active low: reads 0)
+    dev->setInputs(IOX::PORT_B, 0xFF);
+    IOX::init16(0x22, IOX::IN, IOX::IN);
+    IOX::enableInterrupts(0x22, 0xFF, 0xFF);
+    IOX::readChanged(0x22, data);
+    CHECK((data[IOX::PORT_A] == 0x00) && (data[IOX::PORT_B] == 0x00));
+
+    dev->setInputs(IOX::PORT_A, 0xFE);      // bit 0 pulses...
+    dev->setInputs(IOX::PORT_A, 0xFF);      // ... and is over before the next read
+    r = IOX::readChanged(0x22, data);
+    CHECK(r == (IOX::CHANGED | IOX::REREAD));
+    CHECK(data[IOX::PORT_A] == 0x01);
+    CHECK((dev->getRegister(0x0E) | dev->getRegister(0x0F)) == 0);     // no INTF, no interrupt
+
+    r = IOX::readChanged(0x22, data);
+    CHECK(r == 0);
+    CHECK(data[IOX::PORT_A] == 0x00);
+
+    dev->setInputs(IOX::PORT_B, 0x7F);      // a change that stays
+    r = IOX::readChanged(0x22, data);
+    CHECK(r == IOX::CHANGED);
+    CHECK(data[IOX::PORT_B] == 0x80);
+}
+
+void testIOX(void) {
+    queueMerge();
+    shortPulse();
+}
@@ -0,0 +1,33 @@
+//==================================================================================
+//
+//  Output tests: timed outputs
+//
+//==================================================================================
+
+#include "test.h"
+
+using namespace test;
+
+// Timed outputs on a buffer of our own, to see how much of it they use
+class TimedOn : public cpTimedOutputsBase {
+public:
+    TimedOn(byte maxOB, byte *storage) : cpTimedOutputsBase(maxOB, storage) { }
+};
+
+// ----------------------------------------------------------------------
+//  storageSize() is what the constructor carves up, no more and no less:
+//  the output image, the last buffer, ends where the storage does
+// ----------------------------------------------------------------------
+static void timedStorage(void) {
+    static byte storage[cpTimedOutputsBase::storageSize(255)];
+    const byte sizes[] = { 1, 2, cpNodeBase::IO_bufsize, 255 };
+
+    for (unsigned s = 0; s < sizeof(sizes); s++) {
+        TimedOn timed(sizes[s], storage);
+        CHECK(timed.image() + sizes[s] == storage + cpTimedOutputsBase::storageSize(sizes[s]));
+    }
+}
+
+void testOutputs(void) {
+    timedStorage();
+}
@@ -0,0 +1,454 @@
+//==================================================================================
+//
+//  Protocol tests: frames that arrive slowly, stall, or are cut short
+//
+//==================================================================================
+
+#include "test.h"
+
+using namespace test;
+
+static cpNode *logged;
+static byte outputs[2];
+static bool changed[2];
+
+static void unpackLog(byte *OB, int) {
+    outputs[0] = OB[0];
+    outputs[1] = OB[1];
+    changed[0] = logged->outputChanged(0);
+    changed[1] = logged->outputChanged(1);
+}
+
+static void setupNode(cpNode &node, MemStream &port) {
+    cpShim::now_us = 0;
+    logged = &node;
+    node.setCMRIPort(&port);
+    node.setNodeAddress(0);
+    node.setNumOutputBytes(2);
+    node.setUnpackHandler(unpackLog);
+    node.setRXTimeout(1000);
+    outputs[0] = outputs[1] = 0;
+}
+
+// ----------------------------------------------------------------------
+//  A loop() slower than the inter-byte timeout, with the rest of the
+//  frame already waiting in the serial port, is not a stalled host
+// ----------------------------------------------------------------------
+static void slowLoop(void) {
+    cpNode node;
+    MemStream port;
+    byte data[2] = { 0x5A, 0xA5 };
+    std::vector<byte> t = frame(0, 'T', data, sizeof(data));
+
+    setupNode(node, port);
+    port.feed(&t[0], 6);
+    node.proceess();
+    port.feed(&t[6], t.size() - 6);         // arrives while the sketch is busy
+    cpShim::advance(5000);
+    drain(node, port);
+    CHECK((outputs[0] == 0x5A) && (outputs[1] == 0xA5));
+}
+
+// ----------------------------------------------------------------------
+//  A host that really goes quiet mid-frame loses that frame, and the
+//  node picks up the next one
+// ----------------------------------------------------------------------
+static void stalledHost(void) {
+    cpNode node;
+    MemStream port;
+    byte data[2] = { 0x5A, 0xA5 };
+    std::vector<byte> t = frame(0, 'T', data, sizeof(data));
+
+    setupNode(node, port);
+    port.feed(&t[0], 6);
+    node.proceess();
+    cpShim::advance(5000);
+    node.proceess();                        // nothing more has arrived
+    port.feed(&t[6], t.size() - 6);
+    drain(node, port);
+    CHECK((outputs[0] == 0x00) && (outputs[1] == 0x00));
+
+    port.feed(t);
+    drain(node, port);
+    CHECK((outputs[0] == 0x5A) && (outputs[1] == 0xA5));
+}
+
+// ----------------------------------------------------------------------
+//  A T message that times out part way changes no outputs, and a
+//  shorter one after it doesn't send its bytes out either
+// ----------------------------------------------------------------------
+static void cutShort(void) {
+    cpNode node;
+    MemStream port;
+    byte data[2] = { 0x5A, 0xA5 };
+    byte lost[2] = { 0x11, 0x22 };
+    byte next[1] = { 0x66 };
+    std::vector<byte> t = frame(0, 'T', lost, sizeof(lost));
+
+    setupNode(node, port);
+    port.feed(frame(0, 'T', data, sizeof(data)));
+    drain(node, port);
+
+    port.feed(&t[0], t.size() - 1);         // all but the ETX
+    node.proceess();
+    cpShim::advance(5000);
+    node.proceess();                        // times out
+
+    port.feed(frame(0, 'T', next, sizeof(next)));
+    drain(node, port);
+    CHECK((outputs[0] == 0x66) && (outputs[1] == 0xA5));
+    CHECK(changed[0] && !changed[1]);
+}
+
+// ----------------------------------------------------------------------
+//  An Init from a host that sends opts1 as 0 leaves the sketch's
+//  output inversion alone; one that sends option bits sets them all
+// ----------------------------------------------------------------------
+static void initOptions(void) {
+    cpNode node;
+    MemStream port;
+    byte data[2] = { 0x0F, 0x00 };
+    byte plain[]  = { 'C', 0, 0, 0, 0, 0, 0 };
+    byte unpack[] = { 'C', 0, 0, cpNode::OPT_UNPACK_ON_CHANGE, 0, 0, 0 };
+
+    setupNode(node, port);
+    node.setHostConfig(true);
+    node.invertOutputs(true);
+
+    port.feed(frame(0, 'I', plain, sizeof(plain)));
+    port.feed(frame(0, 'T', data, sizeof(data)));
+    drain(node, port);
+    CHECK((outputs[0] == 0xF0) && (outputs[1] == 0xFF));
+
+    port.feed(frame(0, 'I', unpack, sizeof(unpack)));
+    port.feed(frame(0, 'T', data, sizeof(data)));
+    drain(node, port);
+    CHECK((outputs[0] == 0x0F) && (outputs[1] == 0x00));
+}
+
+// Poll responses: the input image pack() gives the node, and a poll
+static byte inputs[4];
+
+static void packInputs(byte *IB, int len) {
+    memcpy(IB, inputs, len);
+}
+
+static std::vector<byte> poll(cpNode &node, MemStream &port) {
+    port.clear();
+    port.feed(frame(0, 'P'));
+    drain(node, port);
+    return port.sent;
+}
+
+static void setupInputs(cpNode &node, MemStream &port) {
+    setupNode(node, port);
+    node.setNumInputBytes(sizeof(inputs));
+    node.setPackHandler(packInputs);
+    memset(inputs, 0, sizeof(inputs));
+}
+
+static void setInputs(byte a, byte b, byte c, byte d) {
+    inputs[0] = a;
+    inputs[1] = b;
+    inputs[2] = c;
+    inputs[3] = d;
+}
+
+// ----------------------------------------------------------------------
+//  The R message kept between polls is patched right when an input byte
+//  changes into or out of a value that needs a DLE in front of it, in
+//  the middle of the frame, so everything after it moves
+// ----------------------------------------------------------------------
+static void pollEscapes(void) {
+    cpNode node;
+    MemStream port;
+    static const byte steps[][4] = {
+        { 0x00, 0x11, 0x22, 0x33 },
+        { 0x00, 0x10, 0x22, 0x33 },         // into DLE, mid frame
+        { 0x00, 0x10, 0x03, 0x33 },         //   ... and the next one too
+        { 0x00, 0x10, 0x03, 0x02 },
+        { 0x00, 0x44, 0x03, 0x02 },         // out of it, the rest moves back
+        { 0x00, 0x44, 0x55, 0x02 },
+        { 0x10, 0x44, 0x55, 0x66 },         // in at the start, out at the end
+        { 0xFF, 0x44, 0x55, 0x66 },         // SYN is never escaped
+    };
+
+    setupInputs(node, port);
+    for (unsigned s = 0; s < sizeof(steps) / sizeof(steps[0]); s++) {
+        setInputs(steps[s][0], steps[s][1], steps[s][2], steps[s][3]);
+        CHECK(poll(node, port) == frame(0, 'R', inputs, sizeof(inputs)));
+    }
+}
+
+// ----------------------------------------------------------------------
+//  The R message kept encoded between polls is byte for byte the one a
+//  node that never answered a poll before encodes, whichever bytes of
+//  the image change to and from STX, ETX, DLE and other values
+// ----------------------------------------------------------------------
+static void pollKept(void) {
+    static const byte values[] = { 0x00, 0x02, 0x03, 0x10, 0xFF, 0x41, 0x12, 0xFE };
+    cpNode kept;
+    MemStream port;
+    unsigned long seed = 1;
+    bool same = true;
+
+    setupInputs(kept, port);
+    for (int s = 0; s < 500; s++) {
+        cpNode fresh;
+        MemStream freshPort;
+
+        for (unsigned b = 0; b < sizeof(inputs); b++) {
+            seed = seed * 1103515245UL + 12345UL;
+            if ((seed >> 16) & 1) {                         // about half the bytes change
+                inputs[b] = values[(seed >> 17) % sizeof(values)];
+            }
+        }
+        std::vector<byte> r = poll(kept, port);
+        fresh.setCMRIPort(&freshPort);
+        fresh.setNodeAddress(0);
+        fresh.setNumInputBytes(sizeof(inputs));
+        fresh.setPackHandler(packInputs);
+        same &= (r == poll(fresh, freshPort));
+    }
+    CHECK(same);
+}
+
+// ----------------------------------------------------------------------
+//  With change reporting, a full R goes out at every fullEvery'th poll
+//  and C messages in between; a new number of input bytes, a Q message,
+//  or a C no shorter than the R, also get an R
+// ----------------------------------------------------------------------
+static void pollChanges(void) {
+    cpNode node;
+    MemStream port;
+    std::vector<byte> r;
+    byte change[2];
+    int p;
+
+    setupInputs(node, port);
+    node.setReportChanges(true, 4);
+    for (p = 0; p < 9; p++) {
+        inputs[1] = 0x20 + p;
+        r = poll(node, port);
+        CHECK(r[4] == (((p % 4) == 0) ? 'R' : 'C'));
+    }
+
+    setInputs(0x00, 0x10, 0x00, 0x00);      // C: map, then the changed byte, DLE escaped
+    change[0] = 0x02;
+    change[1] = 0x10;
+    CHECK(poll(node, port) == frame(0, 'C', change, sizeof(change)));
+    CHECK(poll(node, port) == frame(0, 'C'));                           // nothing changed
+
+    node.setNumInputBytes(sizeof(inputs));
+    CHECK(poll(node, port)[4] == 'R');
+    CHECK(poll(node, port)[4] == 'C');
+
+    port.clear();
+    port.feed(frame(0, 'Q'));
+    drain(node, port);
+    CHECK(port.sent[4] == 'R');
+
+    setInputs(0x01, 0x02, 0x03, 0x00);      // 3 changed + 1 map byte: no shorter than R
+    CHECK(poll(node, port) == frame(0, 'R', inputs, sizeof(inputs)));
+
+    node.setReportChanges(true, 1);         // every poll gets an R
+    for (p = 0; p < 3; p++) {
+        inputs[3] = p + 1;
+        CHECK(poll(node, port)[4] == 'R');
+    }
+
+    node.setReportChanges(true, 0);         // only the first one does
+    for (p = 0; p < 20; p++) {
+        inputs[3] = 0x40 + p;
+        CHECK(poll(node, port)[4] == ((p == 0) ? 'R' : 'C'));
+    }
+}
+
+// A second node on the same board, added with addNode()
+static byte panelIn[2];
+static byte panelOut[2];
+static int panelUnpacks;
+
+static void packPanel(byte *IB, int len) {
+    memcpy(IB, panelIn, len);
+}
+
+static void unpackPanel(byte *OB, int len) {
+    memcpy(panelOut, OB, len);
+    panelUnpacks++;
+}
+
+static void setupPanel(cpNodeSized<2, 2> &panel, byte address) {
+    panel.setNodeAddress(address);
+    panel.setNumInputBytes(sizeof(panelIn));
+    panel.setNumOutputBytes(sizeof(panelOut));
+    panel.setPackHandler(packPanel);
+    panel.setUnpackHandler(unpackPanel);
+    panelIn[0] = 0x03;                      // an ETX and a DLE, escaped in the response
+    panelIn[1] = 0x10;
+    panelOut[0] = panelOut[1] = 0;
+    panelUnpacks = 0;
+}
+
+// ----------------------------------------------------------------------
+//  Polls and T messages for an added node's address reach that node,
+//  up to address 64; those for an address that is on no node of the
+//  board are skipped whole, DLE escapes and all
+// ----------------------------------------------------------------------
+static void addedNodes(void) {
+    cpNode node;
+    cpNodeSized<2, 2> panel;
+    cpNodeSized<2, 2> far;
+    MemStream port;
+    byte data[2] = { 0x5A, 0xA5 };
+    byte stray[2] = { 0x02, 0x10 };         // escaped: must not end the skipped frame early
+
+    setupInputs(node, port);
+    setupPanel(panel, 5);
+    CHECK(node.addNode(panel));
+    CHECK(!node.addNode(panel));            // only once
+    far.setNodeAddress(64);                 // the highest address, past the bitmap's first half
+    far.setNumOutputBytes(2);
+    far.setUnpackHandler(unpackLog);
+    CHECK(node.addNode(far));
+
+    setInputs(0x11, 0x22, 0x33, 0x44);
+    port.clear();
+    port.feed(frame(5, 'P'));
+    drain(node, port);
+    CHECK(port.sent == frame(5, 'R', panelIn, sizeof(panelIn)));
+
+    port.clear();
+    port.feed(frame(6, 'T', stray, sizeof(stray)));
+    port.feed(frame(63, 'P'));
+    port.feed(frame(5, 'T', data, sizeof(data)));
+    drain(node, port);
+    CHECK(port.sent.empty());
+    CHECK((panelUnpacks == 1) && (panelOut[0] == 0x5A) && (panelOut[1] == 0xA5));
+    CHECK((outputs[0] == 0x00) && (outputs[1] == 0x00));
+
+    port.feed(frame(64, 'T', data, sizeof(data)));
+    drain(node, port);
+    CHECK((outputs[0] == 0x5A) && (outputs[1] == 0xA5));
+    CHECK(panelUnpacks == 1);
+
+    CHECK(poll(node, port) == frame(0, 'R', inputs, sizeof(inputs)));
+}
+
+// ----------------------------------------------------------------------
+//  A poll for an added node that arrives while another node's paced
+//  response is still going out is answered once that one is done, not
+//  in the middle of it
+// ----------------------------------------------------------------------
+static void deferredPoll(void) {
+    cpNode node;
+    cpNodeSized<2, 2> panel;
+    MemStream port;
+    byte init[7] = { 'C', 0, 10, 0, 0, 0, 0 };     // DL = 10 x 10us
+    std::vector<byte> both;
+
+    setupInputs(node, port);
+    setupPanel(panel, 5);
+    node.addNode(panel);
+    port.feed(frame(0, 'I', init, sizeof(init)));
+    drain(node, port);
+
+    setInputs(0x11, 0x22, 0x33, 0x44);
+    port.feed(frame(0, 'P'));
+    port.feed(frame(5, 'P'));
+    for (int i = 0; i < 4000; i++) {
+        node.proceess();
+        cpShim::advance(10);
+    }
+    both = frame(0, 'R', inputs, sizeof(inputs));
+    std::vector<byte> r = frame(5, 'R', panelIn, sizeof(panelIn));
+    both.insert(both.end(), r.begin(), r.end());
+    CHECK(port.sent == both);
+}
+
+// ----------------------------------------------------------------------
+//  A node at the largest capacity cpNodeSized<> takes, with every
+//  output byte in use, takes a T message that fills them all
+// ----------------------------------------------------------------------
+static byte widest[255];
+
+static void unpackWidest(byte *OB, int len) {
+    memcpy(widest, OB, len);
+}
+
+static void maxOutputs(void) {
+    cpNodeSized<4, 255> node;
+    MemStream port;
+    byte data[255];
+
+    cpShim::now_us = 0;
+    for (int i = 0; i < 255; i++) {
+        data[i] = i;
+    }
+    node.setCMRIPort(&port);
+    node.setNodeAddress(0);
+    CHECK(node.setNumOutputBytes(255) == 255);
+    node.setUnpackHandler(unpackWidest);
+    port.feed(frame(0, 'T', data, sizeof(data)));
+    drain(node, port);
+    CHECK(memcmp(widest, data, sizeof(data)) == 0);
+}
+
+// <ms> of proceess(), a millisecond at a time
+static void runFor(cpNode &node, int ms) {
+    for (int i = 0; i < ms; i++) {
+        cpShim::advance(1000);
+        node.proceess();
+    }
+}
+
+// ----------------------------------------------------------------------
+//  Timed output settings in an Init message that times out part way
+//  are thrown away with it, and a whole one applies them all
+// ----------------------------------------------------------------------
+static void initCutShort(void) {
+    cpNode node;
+    cpTimedOutputs timed;
+    MemStream port;
+    byte on[2] = { 0xFF, 0xFF };
+    byte init[] = { 'C', 0, 0, 0, 0, 0, 0,                  // a cpNode
+                    0, 0, 0, 10,                            // HOLD 1s
+                    0, cpTimedOutputs::MODE_SAFE_OFF, 0xFF };
+    std::vector<byte> i = frame(0, 'I', init, sizeof(init));
+
+    setupNode(node, port);
+    node.setHostConfig(true);
+    node.setTimedOutputs(&timed);
+
+    port.feed(&i[0], i.size() - 1);         // all but the ETX
+    node.proceess();
+    cpShim::advance(5000);
+    node.proceess();                        // times out
+
+    port.feed(frame(0, 'T', on, sizeof(on)));
+    drain(node, port);
+    runFor(node, 2000);
+    CHECK(!timed.isFailsafe());
+    CHECK((outputs[0] == 0xFF) && (outputs[1] == 0xFF));
+
+    port.feed(i);
+    port.feed(frame(0, 'T', on, sizeof(on)));
+    drain(node, port);
+    runFor(node, 2000);
+    CHECK(timed.isFailsafe());
+    CHECK((outputs[0] == 0x00) && (outputs[1] == 0xFF));
+}
+
+void testProtocol(void) {
+    slowLoop();
+    stalledHost();
+    cutShort();
+    initCutShort();
+    initOptions();
+    pollEscapes();
+    pollKept();
+    pollChanges();
+    addedNodes();
+    deferredPoll();
+    maxOutputs();
+}
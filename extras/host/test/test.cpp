@@ -0,0 +1,80 @@
+//==================================================================================
+//
+//  test - Host tests for the cpNode library
+//
+//      test                run them all
+//      test protocol       run only the named groups
+//
+//==================================================================================
+
+#include "test.h"
+
+// The library's default pack() and unpack(), for nodes without handlers
+extern "C" {
+    void pack(  byte *, int) { }
+    void unpack(byte *, int) { }
+}
+
+static int checks;
+static int failures;
+
+std::vector<byte> test::frame(byte node, char type, const byte *data, int len) {
+    std::vector<byte> f;
+
+    f.push_back(0xFF);          // SYN
+    f.push_back(0xFF);          // SYN
+    f.push_back(0x02);          // STX
+    f.push_back('A' + node);
+    f.push_back(type);
+    for (int i = 0; i < len; i++) {
+        if ((data[i] == 0x02) || (data[i] == 0x03) || (data[i] == 0x10)) {
+            f.push_back(0x10);  // DLE
+        }
+        f.push_back(data[i]);
+    }
+    f.push_back(0x03);          // ETX
+    return f;
+}
+
+void test::drain(cpNodeBase &node, MemStream &port) {
+    do {
+        node.proceess();
+    } while ((port.available() > 0) || (node.isTransmitting()));
+}
+
+bool test::check(bool ok, const char *what, const char *file, int line) {
+    checks++;
+    if (!ok) {
+        failures++;
+        printf("  FAILED %s:%d: %s\n", file, line, what);
+    }
+    return ok;
+}
+
+static const struct {
+    const char *name;
+    void (*fn)(void);
+} groups[] = {
+    { "protocol",   testProtocol },
+    { "inputs",     testInputs },
+    { "outputs",    testOutputs },
+    { "iox",        testIOX },
+    { "clock",      testClock },
+    { "baud",       testBaud },
+};
+
+int main(int argc, char **argv) {
+    for (unsigned g = 0; g < sizeof(groups) / sizeof(groups[0]); g++) {
+        bool run = (argc < 2);
+        for (int a = 1; a < argc; a++) {
+            run |= (strcmp(argv[a], groups[g].name) == 0);
+        }
+        if (run) {
+            int failed = failures;
+            groups[g].fn();
+            printf("%-12s %s\n", groups[g].name, (failures == failed) ? "ok" : "FAILED");
+        }
+    }
+    printf("%d checks, %d failed\n", checks, failures);
+    return failures ? 1 : 0;
+}
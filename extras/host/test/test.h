@@ -0,0 +1,39 @@
+#pragma once
+
+/*
+    ==================================================================================
+                  test.h                Host tests for the cpNode library
+    ==================================================================================
+
+    Checks of library behaviour that is hard to get to happen on a board on
+    purpose: a micros() wrap in the middle of a message, a frame cut short,
+    expander writes queued in an awkward order.  Each group is a function
+    that runs its cases with CHECK(), which prints the condition that failed
+    and where; build/test exits non zero if any did.
+*/
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <MemStream.h>
+#include <cpNode.h>
+#include <vector>
+
+namespace test {
+    // SYN SYN STX <'A'+node> <type> <data, DLE escaped> ETX
+    std::vector<byte> frame(byte node, char type, const byte *data = NULL, int len = 0);
+
+    // proceess() until the node has read everything fed to it and sent its response
+    void drain(cpNodeBase &node, MemStream &port);
+
+    bool check(bool ok, const char *what, const char *file, int line);
+}
+
+#define CHECK(c)    test::check((c), #c, __FILE__, __LINE__)
+
+// Test groups
+void testProtocol(void);
+void testInputs(void);
+void testOutputs(void);
+void testIOX(void);
+void testClock(void);
+void testBaud(void);
@@ -53,20 +53,109 @@ extern "C" {
 }
 
 
-cpNode::cpNode(void) {
+// ----------------------------------------------------------
+//  storage is cpNodeBase::storageSize(maxIB, maxOB)
+//  bytes, provided by cpNodeSized<>
+// ----------------------------------------------------------
+cpNodeBase::cpNodeBase(byte maxIB, byte maxOB, byte *storage) {
+    this->maxIB = maxIB;
+    this->maxOB = maxOB;
+
+    memset(storage, 0, storageSize(maxIB, maxOB));
+    TX_Buf      = storage;          storage += txBufSize(maxIB);
+    IB_last     = storage;          storage += maxIB;
+    IB          = storage;          storage += maxIB;
+    IB_back     = storage;          storage += maxIB;
+    db_state    = storage;          storage += maxIB;
+    db_cnt0     = storage;          storage += maxIB;
+    db_cnt1     = storage;          storage += maxIB;
+    db_cnt2     = storage;          storage += maxIB;
+    db_mask     = storage;          storage += maxIB;
+    OB          = storage;          storage += maxOB;
+    OB_rx       = storage;          storage += maxOB;
+    OB_changed  = storage;
+
     UA  = 0;
     nIB = 0;
     nOB = 0;
+    memset(ua_mask, 0, sizeof(ua_mask));
+    next_node = NULL;
+    primary   = NULL;
+    rx_node   = this;
+    poll_node = NULL;
+    pack_fn   = pack;
+    unpack_fn = unpack;
     DL  = 0;    // CMRINet per-char delay
     debugging = 0;
     invert_in = false;
     invert_out = false;
     Monitor = NULL;
 
+    rx_state   = RX_IDLE;
+    rx_type    = Packet_None;
+    inCnt      = 0;
+    rx_xor     = 0;
+    init_NDP   = 0;
+    init_DL    = 0;
+    init_opts1 = 0;
+    init_opts2 = 0;
+    init_NS    = 0;
+    init_NIN   = 0;
+    init_NOUT  = 0;
+    host_config = false;
+    rx_time    = 0;
+    rx_timeout = 0;    // wait forever for the rest of a message
+    skip_msgs  = 0;
+    skip_bytes = 0;
+    rx_synced  = false;
+    rx_frames  = 0;
+
+    baud_fn      = NULL;
+    baud         = 0;
+    baud_prev    = 0;
+    baud_next    = 0;
+    baud_time    = 0;
+    baud_timeout = 0;
+    baud_frames  = 0;
+    baud_state   = BAUD_LOCKED;
+    baud_try     = 0;
+
+    tx_len = 0;
+    tx_pos = 0;
+    tx_time = 0;
+    tx_valid = false;
+
+    report_changes = false;
+    report_full = true;
+    report_every = 16;
+    report_count = 0;
+
+    tx_de_pin = -1;
+    tx_draining = false;
+    tx_room = 0;
+    poll_time = 0;
+    tx_lead = 0;
+    tx_tail = 0;
+
+    sample_period = 0;
+    sample_time = 0;
+    ib_fresh = false;
+    sample_busy = false;
+    iox_queue = NULL;
+    iox_bank = NULL;
+    stats = NULL;
+    timers = NULL;
+
+    db_samples = 0;
+    db_primed = false;
+    memset(db_mask, 0xFF, maxIB);   // every bit, until setDebounceMask() says otherwise
+
+    ob_valid = false;
+    unpack_on_change = false;
 }
 
 
-byte cpNode::setNodeAddress(byte nodeAddr) {  // Node ID (0..64)
+byte cpNodeBase::setNodeAddress(byte nodeAddr) {  // Node ID (0..64)
     //----------------------------------------------------------------
     // Valid addresses are 0..64
     // Set node address to 64 if an invalid decimal address is passed
@@ -76,36 +165,443 @@ byte cpNode::setNodeAddress(byte nodeAddr) {  // Node ID (0..64)
     }
 
     UA = nodeAddr + UA_Offset;  // 0..64 -> 'A'..DEL
+    tx_valid = false;           // Poll response header needs the new address
+    (primary ? primary : this)->callback_update_Address_Mask();
     return nodeAddr;  // in case it changed...
 }
 
+// ----------------------------------------------------------
+//  Virtual nodes
+//
+//  One board can answer to several node addresses: each extra
+//  address is a node of its own (with its own address, buffers,
+//  pack() and unpack() handlers, options...) added to the node
+//  the sketch calls proceess() on, which receives every message
+//  and hands those for the added nodes to them.  The added nodes
+//  share its serial port and driver enable pin, so set those up
+//  on it first.
+//
+//      cpNode cmri;                    // address 0
+//      cpNodeSized<8, 8> panel;        // address 1
+//      ...
+//      panel.setNodeAddress(1);
+//      panel.setPackHandler(panelPack);
+//      panel.setUnpackHandler(panelUnpack);
+//      cmri.addNode(panel);
+//
+//  Returns false if the node was already added elsewhere.
+// ----------------------------------------------------------
+bool cpNodeBase::addNode(cpNodeBase &node) {
+    cpNodeBase *n;
+
+    if ((&node == this) || (node.primary) || (node.next_node) || (primary)) {
+        return false;
+    }
+    for (n = this; n->next_node; n = n->next_node) {
+        ;
+    }
+    n->next_node = &node;
+    node.primary = this;
+    node.cmriNet = cmriNet;
+    node.Monitor = Monitor;
+    node.tx_de_pin = tx_de_pin;
+    callback_update_Address_Mask();
+    return true;
+}
+
+// ----------------------------------------------------------
+//  Link speed
+//
+//  The CMRI port is set up by the sketch, so changing its speed
+//  is left to a handler the sketch provides, e.g.
+//
+//      void cmriBaud(unsigned long baud) {
+//          Serial.end();
+//          Serial.begin(baud);
+//      }
+//      ...
+//      cmri.setBaudHandler(cmriBaud, CMRINET_SPEED);
+//
+//  With a handler, the host can move the link to a new speed
+//  with opts2 of a cpNode Init message (an index into BaudRates[],
+//  starting at 1; 0 leaves it alone).  The node switches as soon
+//  as it is done transmitting, and goes back to the old speed if
+//  no message header (SYN SYN STX, node address) is seen at the
+//  new one within timeoutMs.
+//
+//  autoBaud() looks for the host's speed at startup instead,
+//  trying each of BaudRates[] for timeoutMs in turn, starting
+//  with the current one, until a message header is seen.
+// ----------------------------------------------------------
+const unsigned long cpNodeBase::BaudRates[cpNodeBase::BaudRateCount] = {
+    9600, 19200, 28800, 38400, 57600, 115200, 230400
+};
+
+void cpNodeBase::setBaudHandler(void (*fn)(unsigned long baud), unsigned long baud, unsigned long timeoutMs) {
+    baud_fn = fn;
+    this->baud = baud;
+    baud_timeout = timeoutMs;
+    baud_state = BAUD_LOCKED;
+    baud_next = 0;
+}
+
+void cpNodeBase::autoBaud(void) {
+    byte i;
+
+    if (!baud_fn) {
+        return;
+    }
+    baud_try = 0;
+    for (i = 0; i < BaudRateCount; i++) {
+        if (BaudRates[i] == baud) {
+            baud_try = i;
+        }
+    }
+    callback_set_Baud(BaudRates[baud_try]);
+    baud_state = BAUD_HUNT;
+}
+
+// ----------------------------------------------------------
+//  Reopen the port at <rate> and start listening afresh
+// ----------------------------------------------------------
+void cpNodeBase::callback_set_Baud(unsigned long rate) {
+    baud = rate;
+    baud_fn(rate);
+    rx_state = RX_IDLE;
+    baud_time = millis();
+    baud_frames = rx_frames;
+}
+
+// ----------------------------------------------------------
+//  Called from proceess() on every pass
+// ----------------------------------------------------------
+void cpNodeBase::callback_check_Baud(void) {
+    if ((baud_next) && !callback_bus_Transmitting()) {
+        if (baud_next != baud) {
+            baud_prev = baud;
+            callback_set_Baud(baud_next);
+            baud_state = BAUD_TRIAL;
+        }
+        baud_next = 0;
+        return;
+    }
+
+    if (baud_state == BAUD_LOCKED) {
+        return;
+    }
+    if (rx_frames != baud_frames) {
+        baud_state = BAUD_LOCKED;           // heard from the host at this speed
+        return;
+    }
+    if (cpElapsed(millis(), baud_time) < baud_timeout) {
+        return;
+    }
+
+    if (baud_state == BAUD_TRIAL) {
+        callback_set_Baud(baud_prev);       // the host didn't follow, go back
+        baud_state = BAUD_LOCKED;
+    } else {
+        baud_try = (baud_try + 1) % BaudRateCount;
+        callback_set_Baud(BaudRates[baud_try]);
+    }
+}
+
+// ----------------------------------------------------------
+//  Rebuild the set of addresses this node answers for
+// ----------------------------------------------------------
+void cpNodeBase::callback_update_Address_Mask(void) {
+    cpNodeBase *n;
+    byte a;
+
+    memset(ua_mask, 0, sizeof(ua_mask));
+    for (n = this; n; n = n->next_node) {
+        a = n->UA - UA_Offset;
+        if (a < 128) {              // not before setNodeAddress()
+            ua_mask[a >> 3] |= (1 << (a & 7));
+        }
+    }
+}
+
+// ----------------------------------------------------------
+//  The node a message addressed to <ua> is for, NULL if none.
+//  Messages for other boards are turned away by the address
+//  mask without looking at the nodes.
+// ----------------------------------------------------------
+cpNodeBase *cpNodeBase::callback_find_Node(byte ua) {
+    byte a = ua - UA_Offset;
+    cpNodeBase *n;
+
+    if ((a >= 128) || !(ua_mask[a >> 3] & (1 << (a & 7)))) {
+        return NULL;
+    }
+    for (n = this; n; n = n->next_node) {
+        if (n->UA == ua) {
+            return n;
+        }
+    }
+    return NULL;
+}
+
+// ----------------------------------------------------------
+//  Is any of the board's nodes still sending a response?
+// ----------------------------------------------------------
+bool cpNodeBase::callback_bus_Transmitting(void) {
+    cpNodeBase *n;
+
+    for (n = this; n; n = n->next_node) {
+        if (n->isTransmitting()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// ----------------------------------------------------------
+//  RS485 Driver Enable
+//
+//  On a half duplex RS485 link the node's transmitter must be
+//  enabled only while it is answering a poll.  If a pin is given
+//  here, it is driven HIGH right before the first byte of a poll
+//  response and LOW as soon as the last stop bit has left the UART.
+// ----------------------------------------------------------
+void cpNodeBase::setTXEnablePin(int pin) {
+    tx_de_pin = pin;
+    if (tx_de_pin >= 0) {
+        digitalWrite(tx_de_pin, LOW);      // Receive
+        pinMode(tx_de_pin, OUTPUT);
+    }
+}
+
+// ----------------------------------------------------------
+//  Write the node's cpNodeStats, if it has one, to the debug
+//  port in the binary form described by cpNodeStats::dump()
+// ----------------------------------------------------------
+void cpNodeBase::dumpStats(void) {
+    if ((stats) && (Monitor)) {
+        stats->dump(Monitor);
+    }
+}
+
+// ----------------------------------------------------------
+//  Print up to TraceDrainMax trace events, one per line, each
+//  with the microseconds since the one before it:
+//
+//      88us UA 'A'
+//      87us type 'T'
+//      87us 0x01
+// ----------------------------------------------------------
+void cpNodeBase::callback_drain_Trace(void) {
+    cpNodeTrace<CPNODE_TRACE>::Event e;
+    unsigned int delta;
+    byte n, lost;
+
+    for (n = 0; (n < TraceDrainMax) && trace.next(e, delta); n++) {
+        if (!Monitor) {
+            continue;
+        }
+        Monitor->print(delta);
+        Monitor->print("us ");
+        switch (e.type) {
+        case TRACE_STX:         Monitor->println("STX");                    break;
+        case TRACE_UA:          Monitor->print("UA '");   Monitor->write(e.data);   Monitor->println("'");          break;
+        case TRACE_FOREIGN:     Monitor->println("not for me");             break;
+        case TRACE_TYPE:        Monitor->print("type '"); Monitor->write(e.data);   Monitor->println("'");          break;
+        case TRACE_BAD_TYPE:    Monitor->print("bad type 0x");  Monitor->println(e.data, HEX);                      break;
+        case TRACE_DATA:        Monitor->print("0x");           Monitor->println(e.data, HEX);                      break;
+        case TRACE_DLE:         Monitor->print("DLE 0x");       Monitor->println(e.data, HEX);                      break;
+        case TRACE_ETX:         Monitor->print("ETX, ");  Monitor->print(e.data);   Monitor->println(" bytes");     break;
+        case TRACE_TOO_LONG:    Monitor->println("too long");               break;
+        case TRACE_TIMEOUT:     Monitor->println("RX timeout");             break;
+        default:                Monitor->println(e.type);                   break;
+        }
+    }
+
+    if ((n < TraceDrainMax) && ((lost = trace.takeDropped()) > 0) && (Monitor)) {
+        Monitor->print(lost);
+        Monitor->println(" trace events lost");
+    }
+}
+
+// ----------------------------------------------------------
+//  Background input sampling
+//
+//  By default pack() is called when a poll arrives, which puts
+//  any slow input reads (I2C expanders...) between the poll and
+//  the response.  With a sample period set, proceess() calls pack()
+//  every <usec> microseconds between polls instead, and a poll
+//  just picks up the latest sample.  0 goes back to pack() on poll.
+// ----------------------------------------------------------
+void cpNodeBase::setInputSamplePeriod(unsigned long usec) {
+    sample_period = usec;
+    sample_time = micros() - usec;     // take the first sample right away
+    ib_fresh = false;
+    sample_busy = false;
+}
+
+// ----------------------------------------------------------
+//  Input debouncing
+//
+//  An input change is only reported after it has been seen in
+//  <samples> consecutive background samples (1..7), taken every
+//  <usec> microseconds.  0 samples turns debouncing off.
+//  All input bits are debounced unless masked off with
+//  setDebounceMask(), before or after this.
+//
+//  Debouncing needs background sampling, so a sample period
+//  of 0 is refused (returns false, nothing changes) unless
+//  samples is 0 too.
+// ----------------------------------------------------------
+bool cpNodeBase::setDebounce(byte samples, unsigned long usec) {
+    if ((samples) && (usec == 0)) {
+        return false;
+    }
+    if (samples > 7) {
+        samples = 7;                   // as far as a 3 bit counter goes
+    }
+    db_samples = samples;
+    db_primed = false;
+    setInputSamplePeriod(usec);
+    return true;
+}
+
+// ----------------------------------------------------------
+//  Timed outputs (flashers, pulses, failsafe), see
+//  cpTimedOutputsBase.  They must cover every output byte
+//  the node can have.  NULL goes back to plain outputs.
+// ----------------------------------------------------------
+bool cpNodeBase::setTimedOutputs(cpTimedOutputsBase *t) {
+    if ((t) && (t->getMaxOutputBytes() < maxOB)) {
+        return false;
+    }
+    timers = t;
+    ob_valid = false;                  // write everything on the next change
+    return true;
+}
+
 // ***************************************************
 // *******      Packet Processing Loop      **********
 // ***************************************************
-void cpNode::proceess(void) {
+void cpNodeBase::proceess(void) {
+    cpNodeBase *n;
+    unsigned long start = stats ? micros() : 0;
+    int type;
+
+    //----------------------------------------------
+    //  Keep any paced poll response moving, and
+    //  answer a poll that arrived while the previous
+    //  response was still going out
+    //----------------------------------------------
+    for (n = this; n; n = n->next_node) {
+        n->callback_CMRI_Transmit();
+    }
+    if (poll_node && !callback_bus_Transmitting()) {
+        n = poll_node;
+        poll_node = NULL;
+        n->callback_pack_Node_Inputs();
+        n->callback_CMRI_Poll_Response();
+    }
+
     //----------------------------------------------
     //  Check for any messages from the host
+    //  Only the bytes already received are parsed,
+    //  so this returns without waiting for the rest
+    //  of a partially received message.
     //----------------------------------------------
-    switch( getPacket() ) {
+    type = getPacket();
+    if ((stats) && (type >= Packet_Init)) {
+        stats->count(cpNodeStats::COUNT_INIT + (type - Packet_Init));
+    }
+    if ((type >= Packet_Init) && (type != Packet_Read) && (rx_node->timers)) {
+        rx_node->timers->heard();                                     // the host is still there
+    }
+    switch( type ) {
       case Packet_None:     break;                           // No data received, ignore
 
-      case Packet_Init:     callback_initialize_cpNode();    // "I" Initialize        HOST -> NODE, set configuration parameters
+      case Packet_Init:     rx_node->callback_initialize_cpNode();    // "I" Initialize        HOST -> NODE, set configuration parameters
                             break;
 
-      case Packet_Poll:                                      // "P" Poll              HOST -> NODE request for input data
-                            callback_pack_Node_Inputs();     // Read the input bits and latch for poll response
-                            callback_CMRI_Poll_Response();   // "R" Receive           NODE -> HOST send input port data to host
+      case Packet_Query:    rx_node->report_full = true;              // "Q" Query             HOST -> NODE request for all the input data
+                            // FALLTHROUGH
+      case Packet_Poll:                                               // "P" Poll              HOST -> NODE request for input data
+                            rx_node->poll_time = micros();
+                            if (callback_bus_Transmitting()) {        // Answer once the last response has left
+                                poll_node = rx_node;
+                                break;
+                            }
+                            rx_node->callback_pack_Node_Inputs();     // Read the input bits and latch for poll response
+                            rx_node->callback_CMRI_Poll_Response();   // "R" Receive           NODE -> HOST send input port data to host
                             break;
 
-      case Packet_Transmit: callback_unpack_Node_Outputs();  // "T" Transmit (Write)  HOST -> NODE, set output bits
+      case Packet_Transmit: rx_node->callback_accept_Node_Outputs(inCnt);
+                            rx_node->callback_unpack_Node_Outputs();  // "T" Transmit (Write)  HOST -> NODE, set output bits
                             break;
 
+      case Packet_Read:     break;                           // "R" from another node, already read to ETX
+
       case Packet_Err:      // FALLTHROUGH
       case Packet_Ignore:   // FALLTHROUGH
       default:              callback_flush_CMRInet_to_ETX(); // Flush input buffer to ETX for various reasons
                             break;
 
      }
+
+    //----------------------------------------------
+    //  Change link speed, or go back, if need be
+    //----------------------------------------------
+    if (baud_fn) {
+        callback_check_Baud();
+    }
+
+    //----------------------------------------------
+    //  Print the trace between messages
+    //----------------------------------------------
+    if ((CPNODE_TRACE) && (trace.pending()) && (rx_state == RX_IDLE) &&
+        (!callback_bus_Transmitting()) && (cmriNet->available() <= 0)) {
+        callback_drain_Trace();
+    }
+
+    //----------------------------------------------
+    //  Run the next queued expander transaction,
+    //  sample the inputs in the background, and
+    //  update any flashing or pulsed outputs
+    //----------------------------------------------
+    for (n = this; n; n = n->next_node) {
+        if ((n->iox_queue) && ((n == this) || (n->iox_queue != iox_queue))) {
+            n->iox_queue->poll();
+        }
+        n->callback_sample_Node_Inputs();
+        if (n->timers) {
+            n->callback_run_Output_Timers();
+        }
+    }
+
+    if (stats) {
+        stats->record(cpNodeStats::HIST_LOOP, cpElapsed(micros(), start));
+    }
+}
+
+//----------------------------------------------
+//  Sample the inputs in the background if asked.
+//  If pack() queued its expander reads, the
+//  sample is finished once they have all landed.
+//----------------------------------------------
+void cpNodeBase::callback_sample_Node_Inputs(void) {
+    if (sample_period) {
+        if ((!sample_busy) && (cpElapsed(micros(), sample_time) >= sample_period)) {
+            sample_time = micros();
+            ib_fresh = false;                // IB_back is about to be overwritten
+            callback_read_Node_Inputs(IB_back);
+            sample_busy = true;
+        }
+        if ((sample_busy) && !((iox_queue) && (iox_queue->pending()))) {
+            callback_latch_Node_Inputs(IB_back);
+            if (db_samples) {
+                callback_debounce_Node_Inputs(IB_back);
+            }
+            sample_busy = false;
+            ib_fresh = true;
+        }
+    }
 }
 
 
@@ -123,58 +619,236 @@ void cpNode::proceess(void) {
 //
 //  Two bytes are stored for "onboard IO bits", IB[0] and IB[1]
 //  The rest of the bytes are used by the optional IO expanders
+//
+//  When sampling in the background, the inputs have already been read
+//  into IB_back and only need to be swapped in.
+//-----------------------------------------------------------------------
+void cpNodeBase::callback_pack_Node_Inputs() {
+    if (sample_period) {
+        if (ib_fresh) {
+            byte *t = IB;
+            IB = IB_back;
+            IB_back = t;
+            ib_fresh = false;
+        }
+        return;
+    }
+
+    callback_read_Node_Inputs(IB);
+    if (iox_queue) {
+        iox_queue->flush();     // the host is waiting: finish any queued reads now
+    }
+    callback_latch_Node_Inputs(IB);
+}
+
+//-----------------------------------------------------------------------
+//  Read all the inputs into buf.
+//
+//  The latched inputs are cleared before each pack(), so any bytes
+//  the sketch does not fill in are reported as 0 (before inversion).
+//  Expander reads pack() puts in an IOXQueue land in buf later.
+//  Ports in an IOXBank are read after pack() has done the onboard bytes.
 //-----------------------------------------------------------------------
-void cpNode::callback_pack_Node_Inputs() {
-    pack(IB, nIB);    // links against function found in user's sketch
+void cpNodeBase::callback_read_Node_Inputs(byte *buf) {
+    unsigned long start = stats ? micros() : 0;
 
+    memset(buf, 0, nIB);
+    pack_fn(buf, nIB);     // links against function found in user's sketch, unless setPackHandler()
+    if (iox_bank) {
+        iox_bank->read(buf, nIB, iox_queue);
+    }
+    if (stats) {
+        stats->record(cpNodeStats::HIST_PACK, cpElapsed(micros(), start));
+    }
+}
+
+//-----------------------------------------------------------------------
+//  Finish a set of inputs once all of it has been read
+//-----------------------------------------------------------------------
+void cpNodeBase::callback_latch_Node_Inputs(byte *buf) {
     if (invert_in) {
         for (byte i = 0; i < nIB; i++) {
-                IB[i] = ~(IB[i]);
+                buf[i] = ~(buf[i]);
         }
     }
 }
 
+//-----------------------------------------------------------------------
+//  Debounce a fresh sample in buf, replacing it with the debounced inputs.
+//
+//  Each bit of a byte is an independent lane with its own 3 bit counter,
+//  stored "vertically" (bit n of db_cnt0/1/2 is lane n's counter), so a
+//  handful of bitwise operations debounces 8 inputs at once:
+//    - a lane whose sample matches the debounced state resets its counter
+//    - a lane that differs counts up, and flips once it reaches db_samples
+//-----------------------------------------------------------------------
+void cpNodeBase::callback_debounce_Node_Inputs(byte *buf) {
+    byte i;
+    byte delta, hit;
+    byte c0, c1, c2;
+
+    if (!db_primed) {
+        memcpy(db_state, buf, nIB);
+        memset(db_cnt0, 0, nIB);
+        memset(db_cnt1, 0, nIB);
+        memset(db_cnt2, 0, nIB);
+        db_primed = true;
+        return;
+    }
+
+    // Counter value to match, one full byte per counter bit
+    const byte t0 = (db_samples & 1) ? 0xFF : 0x00;
+    const byte t1 = (db_samples & 2) ? 0xFF : 0x00;
+    const byte t2 = (db_samples & 4) ? 0xFF : 0x00;
+
+    for (i = 0; i < nIB; i++) {
+        delta = buf[i] ^ db_state[i];
+
+        // count up the lanes that differ, clear the rest
+        c2 = (db_cnt2[i] ^ (db_cnt1[i] & db_cnt0[i])) & delta;
+        c1 = (db_cnt1[i] ^ db_cnt0[i]) & delta;
+        c0 = (~db_cnt0[i]) & delta;
+
+        // flip the lanes that reached the count, and those not being debounced
+        hit = (delta & ~(c0 ^ t0) & ~(c1 ^ t1) & ~(c2 ^ t2)) | (delta & ~db_mask[i]);
+
+        db_state[i] ^= hit;
+        db_cnt0[i] = c0 & ~hit;
+        db_cnt1[i] = c1 & ~hit;
+        db_cnt2[i] = c2 & ~hit;
+
+        buf[i] = db_state[i];
+    }
+}
+
 // --------------------------------------------------------------------------
 //  The output routines takes received bits from the ouput buffer and
 //  writes them to the correct output port using digitalWrite() based
 //  upon the value of cpNode_ioMap
+//
+//  The T message's bytes have already been decoded as they arrived
+//  (see callback_store_CMRI_Byte()) and copied into OB at its ETX, and
+//  each byte that differs from what unpack() was last given is flagged
+//  as changed; unpack() can ask with outputChanged(i) and skip the ports
+//  that don't need rewriting.  With setUnpackOnChange(true), unpack()
+//  isn't called at all when the host sent the same outputs again.
+//
+//  A T message shorter than nOB leaves the rest of OB as it was.
+//
+//  With timed outputs, OB is what the host asked for, and unpack() is
+//  given the outputs the timers make of it instead; the changed flags
+//  are then for those.
 //---------------------------------------------------------------------------
-void cpNode::callback_unpack_Node_Outputs() {
-    // Move the received bytes to the output buffer
-    //---------------------------------------------
-    for (byte i=0; i < nOB; i++) {
-        OB[i] = CMRInet_Buf[i];
-        if (invert_out) {
-            OB[i] = ~(OB[i]);   // invert the bits if not active-low
+void cpNodeBase::callback_accept_Node_Outputs(int len) {
+    byte i;
+
+    if (len > nOB) {
+        len = nOB;
+    }
+    for (i = 0; i < len; i++) {
+        if (OB_rx[i] != OB[i]) {
+            OB[i] = OB_rx[i];
+            OB_changed[i >> 3] |= (1 << (i & 7));
         }
     }
+}
+
+void cpNodeBase::callback_unpack_Node_Outputs() {
+    if (timers) {
+        if (ob_valid) {
+            memset(OB_changed, 0, (maxOB + 7) / 8);
+        }
+        timers->run(OB, OB_changed, nOB, invert_out ? 0xFF : 0x00, true);
+    }
+    callback_write_Node_Outputs();
+}
+
+void cpNodeBase::callback_write_Node_Outputs() {
+    unsigned long start = stats ? micros() : 0;
+    byte *image = timers ? timers->image() : OB;
+    byte changed = 0;
+    byte i;
+
+    if (!ob_valid) {
+        memset(OB_changed, 0xFF, (maxOB + 7) / 8);
+        ob_valid = true;
+    }
+    for (i = 0; i < (nOB + 7) / 8; i++) {        // by bitmap byte, so nOB up to 255 can't wrap i
+        changed |= OB_changed[i];
+    }
+
+    if (changed || !unpack_on_change) {
+        unpack_fn(image, nOB);    // links against function found in user's sketch, unless setUnpackHandler()
+    }
+    if (iox_bank) {
+        iox_bank->write(image, nOB, OB_changed, iox_queue);
+    }
+    memset(OB_changed, 0, (maxOB + 7) / 8);
+    if (stats) {
+        stats->record(cpNodeStats::HIST_UNPACK, cpElapsed(micros(), start));
+    }
+}
 
-    unpack(OB, nOB);    // links against function found in user's sketch
+//----------------------------------------------
+//  Flashers, pulse ends and the failsafe change
+//  the outputs without a T message
+//----------------------------------------------
+void cpNodeBase::callback_run_Output_Timers() {
+    if (timers->run(OB, OB_changed, nOB, invert_out ? 0xFF : 0x00, false)) {
+        callback_write_Node_Outputs();
+    }
 }
 
 //-----------------------------------
 //CMRInet Option Bit ProcessING
+//  opts1 of 0, what a host that knows
+//  nothing of them sends, leaves the
+//  sketch's settings alone
 //-----------------------------------
-void cpNode::callback_process_cpNode_Options() {
-    // CPNODE IGNORES OPTION BITS
+void cpNodeBase::callback_process_cpNode_Options() {
+    report_full = true;
+    if (init_opts1 == 0) {
+        return;
+    }
+    if (init_opts1 & OPT_NO_TX_PACING) {
+        DL = 0;
+    }
+    unpack_on_change = (init_opts1 & OPT_UNPACK_ON_CHANGE) != 0;
+    invert_in        = (init_opts1 & OPT_INVERT_INPUTS)    != 0;
+    invert_out       = (init_opts1 & OPT_INVERT_OUTPUTS)   != 0;
+    report_changes   = (init_opts1 & OPT_REPORT_CHANGES)   != 0;
 }
 
 //-----------------------------------------------------------------------------------------
 //  Perform any initialization and setup using the initialization message
-//  NDP must be a "C" (cpNode) for initialization to be done
 //
 //    - cpNode Initialization Message (I)
 //      SYN SYN STX <UA> <I><NDP> <DLH><DLL> <opts1><opts2> <NIN><NOUT> <000000><ETX>
+//      optionally followed by timed output settings (see cpTimedOutputsBase::configure())
+//      <FLASH0><FLASH1><PULSE><HOLD> <OB byte><mode><bits> ...
+//
+//    - SMINI, USIC and SUSIC Initialization Message (I)
+//      SYN SYN STX <UA> <I><NDP> <DLH><DLL> <NS> <CT(1)><CT(NS)> ETX
+//
+//  The transmit delay is always used.  The rest is only applied if the
+//  sketch allowed it with setHostConfig(true):
+//    - cpNode:  option bits, and the number of input and output bytes
+//               (0 leaves the sketch's setting alone)
+//    - SMINI:   3 input and 6 output bytes
+//    - USIC:    3 bytes for each input and output card in the CT table
+//    - SUSIC:   4 bytes per card
+//  A change in the number of bytes is limited to the node's capacity.
 //-----------------------------------------------------------------------------------------
-void cpNode::callback_initialize_cpNode() {
+void cpNodeBase::callback_initialize_cpNode() {
     int DLH = 0,
         DLL = 0;
+    int in, out;
 
     // Set up transmit delay
     // 1 unit of delay(DL) is 10 microseconds
     //----------------------------------------
-    DLH = CMRInet_Buf[1];
-    DLL = CMRInet_Buf[2];
+    DLH = init_DL >> 8;
+    DLL = init_DL & 0xFF;
     DL  = (DLH * 256) + DLL;    // Transmit character delay value in 10 us increments
     DL  = DL * 10;
 
@@ -184,279 +858,600 @@ void cpNode::callback_initialize_cpNode() {
         Monitor->print(debug_buffer);
     }
 
-    // Check if initialize message is for a cpNode
-    // if so, process any options
-    //--------------------------------------------
-    if (cpNODE_NDP == CMRInet_Buf[0]) {
-        callback_process_cpNode_Options();
+    // A new link speed, if the sketch allows it
+    //-----------------------------------------
+    if ((init_NDP == cpNODE_NDP) && (init_opts2 > 0) && (init_opts2 <= BaudRateCount)) {
+        (primary ? primary : this)->baud_next = BaudRates[init_opts2 - 1];
+    }
+
+    if (!host_config) {
+        return;
+    }
+
+    // Work out the I/O size from the node type
+    //-----------------------------------------
+    switch (init_NDP) {
+    case cpNODE_NDP:    // Check if initialize message is for a cpNode
+                        // if so, process any options
+                        //--------------------------------------------
+                        callback_process_cpNode_Options();
+                        if (timers) {
+                            timers->applyConfig();
+                        }
+                        in  = init_NIN  ? init_NIN  : nIB;
+                        out = init_NOUT ? init_NOUT : nOB;
+                        break;
+    case SMINI_NDP:     in  = 3;
+                        out = 6;
+                        break;
+    case USIC_NDP:      in  = init_NIN  * 3;
+                        out = init_NOUT * 3;
+                        break;
+    case SUSIC_NDP:     in  = init_NIN  * 4;
+                        out = init_NOUT * 4;
+                        break;
+    default:            return;
+    }
+
+    if (in != nIB) {
+        setNumInputBytes((in > 255) ? 255 : in);
+        db_primed = false;
+    }
+    if (out != nOB) {
+        setNumOutputBytes((out > 255) ? 255 : out);
+    }
+    tx_valid = false;           // inversion may have changed too
+
+    if ((Monitor) && ((debugging) & (DEBUG_INIT))) {
+        sprintf(debug_buffer, "INIT: NDP=%c nIB=%d nOB=%d opts=0x%02x\n",
+                        init_NDP, nIB, nOB, init_opts1 );
+        Monitor->print(debug_buffer);
+    }
+
+    // Turn everything off, if asked
+    //------------------------------
+    if ((init_NDP == cpNODE_NDP) && (init_opts1 & OPT_CLEAR_OUTPUTS)) {
+        memset(OB, invert_out ? 0xFF : 0x00, nOB);
+        ob_valid = false;
+        callback_unpack_Node_Outputs();
     }
 }
 
 
 // -----------------------------------------------------
-//  FLUSH the serial input buffer until an ETX
-//  is seen or the input serial buffer is empty.
+//  FLUSH the serial input until an ETX is seen.
 //
 //  Used to ignore any inbound messages
 //  not addressed to the node or to re-SYNc the protocol
 //  parser if a garbled message found is.
+//
+//  The parser discards the bytes as they arrive, so this
+//  does not wait for the ETX to show up.
 // -----------------------------------------------------
-void cpNode::callback_flush_CMRInet_to_ETX() {
-    boolean done = false;
-    while (!done) {
-        if (cmriNet->available()) {
-            if (cmriNet->read() == ETX) {
-                done = true;
-            }
-         } else {
-            done = true;
-         }
-    }
+void cpNodeBase::callback_flush_CMRInet_to_ETX() {
+    rx_state = RX_FLUSH;
 }
 
 
 // ----------------------------------------------------------
 // Send the input bytes to the host in response to a poll message.
-// Bytes are moved from the IB(n) buffer to the transmit buffer.
-// DLE characters are inserted for data values which are also
-// protocol characters.
+//
+// The R message is kept in TX_Buf already encoded, and only the
+// part after the first input byte that changed since the last poll
+// is rebuilt, so the response is usually ready to go as-is.
 //
 //    - Read Data (R) Message
 //      SYN SYN STX <UA> <R><IB(1)><IB(NS)> ETX
 //
+// With change reporting on, a C message with just the changed
+// bytes is sent instead (see callback_change_Poll_Response()),
+// except for every report_every'th poll, a Q message, or when
+// the C message would be no shorter than the R message.
 //------------------------------------------------------------*/
-void cpNode::callback_CMRI_Poll_Response() {
-    int i=0;
-    int   c;            // Handy character variable
-
-    // Packet Header
-    //--------------
-    CMRInet_Buf[i++] = SYN;
-    CMRInet_Buf[i++] = SYN;
-    CMRInet_Buf[i++] = STX;
-
-    // Message Header
-    //---------------
-    CMRInet_Buf[i++] = UA;
-    CMRInet_Buf[i++] = 'R';
-
-    // Load the onboard input bytes into the output buffer
-    //----------------------------------------------------
-    if (nIB > 0) {
-        for (byte j=0; j < nIB; j++) {
-            c = IB[j];  // Insert a DLE if the output byte value is a protocol character
-            switch(c)  {
-            //  case SYN:   // SYNcs are ignored to conform to the published protocol
-                case STX:
-                case ETX:
-                case DLE:
-                          CMRInet_Buf[i++] = DLE;
-                          break;
+void cpNodeBase::callback_CMRI_Poll_Response() {
+    byte i;
+    byte pos;
+
+    if ((report_changes) && (!report_full) &&
+        ((report_every == 0) || (report_count + 1 < report_every)) &&
+        (callback_change_Poll_Response())) {
+        report_count++;
+    } else {
+        report_full = false;
+        report_count = 0;
+
+        if (!tx_valid) {
+            callback_update_Poll_Response(0);
+        } else {
+            // Walk the encoded message looking for the first changed byte.
+            // A change that keeps the same DLE escaping is patched in place.
+            //---------------------------------------------------------------
+            pos = 5;
+            for (i = 0; i < nIB; i++) {
+                if (IB[i] != IB_last[i]) {
+                    if (needsDLE(IB[i]) != needsDLE(IB_last[i])) {
+                        callback_update_Poll_Response(i);
+                        break;
+                    }
+                    IB_last[i] = IB[i];
+                    TX_Buf[pos + needsDLE(IB[i])] = IB[i];
+                }
+                pos += 1 + needsDLE(IB_last[i]);
             }
-            CMRInet_Buf[i++] = c;
-            IB[j] = 0;   // Clear the latched inputs
         }
     }
 
-
-
-    // Add the ETX and send the complete buffer
-    //-----------------------------------------
-    CMRInet_Buf[i++] = ETX;
-
-    // Send the packet to the host
-    //----------------------------
-    for (byte j=0; j<i; j++) {
-        cmriNet->write(CMRInet_Buf[j]);
-
-        // If a transmit delay was set, delay microseconds
-        //------------------------------------------------
-        if (DL > 0) {
-            delayMicroseconds( DL );   // value in microseconds
-        }
-    }
+    // Start sending the complete buffer
+    //----------------------------------
+    tx_pos = 0;
+    callback_CMRI_Transmit();
 
     if ((Monitor) && ((debugging) & (DEBUG_POLL))) {
         sprintf(debug_buffer, "Poll Response nIB=%d [\n", nIB );
-        const char *sep = "";
-        for (byte j=0; j<i; j++) {
-            char item[8];
-            sprintf(item, "%s0x%02x", sep, CMRInet_Buf[j]);
-            strcat(debug_buffer, item);
-            sep = ", ";
-        }
-        strcat(debug_buffer, "]\n");
         Monitor->print(debug_buffer);
+        for (byte j=0; j<tx_len; j++) {
+            sprintf(debug_buffer, "%s0x%02x", (j ? ", " : ""), TX_Buf[j]);
+            Monitor->print(debug_buffer);
+        }
+        Monitor->print("]\n");
     }
 }
 
 
-// --------------------------------------------------------
-//  Read a byte from the specified serial port.
-//  Return the character read
-// --------------------------------------------------------
-char cpNode::callback_read_CMRI_Byte() {
-    while (true) {
-        if (cmriNet->available() > 0) {
-            return char(cmriNet->read());
+// ----------------------------------------------------------
+// (Re)build the encoded R message in TX_Buf, starting with
+// input byte <from>; everything before it is already in place.
+// DLE characters are inserted for data values which are also
+// protocol characters.
+//------------------------------------------------------------
+void cpNodeBase::callback_update_Poll_Response(byte from) {
+    byte i;
+    byte pos = 0;
+
+    if (from == 0) {
+        // Packet Header
+        //--------------
+        TX_Buf[pos++] = SYN;
+        TX_Buf[pos++] = SYN;
+        TX_Buf[pos++] = STX;
+
+        // Message Header
+        //---------------
+        TX_Buf[pos++] = UA;
+        TX_Buf[pos++] = 'R';
+    } else {
+        pos = 5;
+        for (i = 0; i < from; i++) {
+            pos += 1 + needsDLE(IB_last[i]);
         }
     }
-}
 
+    // Load the input bytes into the output buffer
+    //--------------------------------------------
+    for (i = from; i < nIB; i++) {
+        IB_last[i] = IB[i];
+        pos = callback_encode_CMRI_Byte(pos, IB[i]);
+    }
+
+    // Add the ETX
+    //------------
+    TX_Buf[pos++] = ETX;
 
-// ----------------------------------------------------------------------
-//  Read the message from the Host and determine if the message is
-//  for this node.  The whole message is read, any data to be processed
-//  is stored in CMRInet_Buf[], stripped of protocol characters.
-//
-//  If the node address does not match, the data is ignored.
-//
-//  The data message body is processed by an appropriate message handler.
+    tx_len = pos;
+    tx_valid = true;
+}
+
+// ----------------------------------------------------------
+// Build a change of state message in TX_Buf, reporting the
+// input bytes that differ from the last ones sent (IB_last):
 //
-//    - Initialization Packet (I)
-//      SYN SYN STX <UA> <I> <NDP> <dH><dL> <NS> <CT(1)><CT(NS)> ETX
+//    - Change (C) Message
+//      SYN SYN STX <UA> <C><MAP(1)><MAP(NM)><IB(i)>...<IB(j)> ETX
 //
-//    - Poll for Data (P)
-//      SYN SYN STX <UA> <P> ETX
+// MAP is a bitmap of the changed bytes, bit 0 of MAP(1) for IB[0]
+// and so on, NM = (nIB + 7) / 8, followed by just those bytes in
+// order.  With no change there is no data at all:
+//      SYN SYN STX <UA> <C> ETX
 //
-//    - Read Data (R)
-//      SYN SYN STX <UA> <R> <IB(1)><IB(NS)> ETX
-//----------------------------------------------------------------------
-
-int cpNode::getPacket() {
-    byte resp = Packet_Err;
-    int  inCnt;
-    int   c;            // Handy character variable
-
-    boolean reading = true,
-            inData = false;
+// Returns false, leaving TX_Buf alone, if so much changed that a
+// full R message would be as short.  TX_Buf no longer holds an R
+// message afterwards.
+//------------------------------------------------------------
+bool cpNodeBase::callback_change_Poll_Response(void) {
+    byte i, k;
+    byte n = 0;
+    byte nmap = (nIB + 7) / 8;
+    byte pos = 0;
+    byte bits;
+
+    for (i = 0; i < nIB; i++) {
+        if (IB[i] != IB_last[i]) {
+            n++;
+        }
+    }
+    if ((n > 0) && (n + nmap >= nIB)) {
+        return false;
+    }
 
-    //-----------------------------------
-    // Check input buffer for a character
-    //-----------------------------------
-    if (cmriNet->available() <= 0) {
-       return Packet_None;
+    TX_Buf[pos++] = SYN;
+    TX_Buf[pos++] = SYN;
+    TX_Buf[pos++] = STX;
+    TX_Buf[pos++] = UA;
+    TX_Buf[pos++] = 'C';
+
+    if (n > 0) {
+        for (i = 0; i < nIB; i += 8) {
+            bits = 0;
+            for (k = 0; (k < 8) && (i + k < nIB); k++) {
+                if (IB[i + k] != IB_last[i + k]) {
+                    bits |= (1 << k);
+                }
+            }
+            pos = callback_encode_CMRI_Byte(pos, bits);
+        }
+        for (i = 0; i < nIB; i++) {
+            if (IB[i] != IB_last[i]) {
+                IB_last[i] = IB[i];
+                pos = callback_encode_CMRI_Byte(pos, IB[i]);
+            }
+        }
     }
 
-    //--------------------
-    // Process the message
-    //--------------------
-    byte matchID = 0;
-    inCnt = 0;
+    TX_Buf[pos++] = ETX;
 
-    do {
-        c = callback_read_CMRI_Byte();  // read the byte
+    tx_len = pos;
+    tx_valid = false;
+    return true;
+}
 
-        switch( int(c) ) {
-        case STX:   // Start of message header, start parsing protocol message
-                    if ((Monitor) && ((debugging) & (DEBUG_PROTOCOL))) { Monitor->print("STX "); }
+// ----------------------------------------------------------
+// Put one data byte into TX_Buf at pos, with a DLE in front of
+// it if needed.  Returns the position after it.
+// SYNcs are not escaped, to conform to the published protocol.
+//------------------------------------------------------------
+byte cpNodeBase::callback_encode_CMRI_Byte(byte pos, byte c) {
+    if (needsDLE(c)) {
+        TX_Buf[pos++] = DLE;
+    }
+    TX_Buf[pos++] = c;
+    return pos;
+}
 
-                    // Read node address and message type
-                    //-----------------------------------
-                    matchID = callback_read_CMRI_Byte();  // Node Address
 
-                    if ((Monitor) && ((debugging) & (DEBUG_PROTOCOL))) {
-                        sprintf(debug_buffer, " ua=%c (%d)", matchID, matchID-UA_Offset);
-                        Monitor->print(debug_buffer);
-                    }
+// ----------------------------------------------------------
+// Send the staged poll response to the host.
+//
+// Without a transmit delay the whole frame is handed to the
+// serial port in one write.  If the host asked for a delay (DL)
+// in the Init message, one byte is sent per call, DL microseconds
+// apart, and proceess() keeps calling back until it is all gone.
+//
+// With an RS485 driver enable pin, the driver is turned on just
+// before the first byte, and turned off once the serial port's
+// transmit buffer has drained and flush() reports that the last
+// byte has been completely shifted out (TX complete).
+//------------------------------------------------------------
+void cpNodeBase::callback_CMRI_Transmit() {
+    unsigned long now;
+
+    if (tx_draining) {
+        if ((tx_room > 0) && (cmriNet->availableForWrite() < tx_room)) {
+            return;                          // Still bytes in the serial buffer
+        }
+        cmriNet->flush();                    // at most the last byte or two in the UART
+        digitalWrite(tx_de_pin, LOW);
+        tx_tail = cpElapsed(micros(), tx_time);
+        tx_draining = false;
+        return;
+    }
 
-                    // If node ID does not match, exit and flush to ETX in outer loop
-                    //---------------------------------------------------------------
-                    if (matchID != UA)  {
-                          if ((Monitor) && ((debugging) & (DEBUG_PROTOCOL))) { Monitor->print("Not for me\n"); }
-                          resp = Packet_Ignore;
-                          reading=false;
-                    } else {
-                         // Set response code based upon message type
-                         //------------------------------------------
-                         c = callback_read_CMRI_Byte();        // Message Type
-
-                         if ((Monitor) && ((debugging) & (DEBUG_PROTOCOL))) {
-                             sprintf(debug_buffer, " MsgType=%c IB=", c);
-                             Monitor->print(debug_buffer);
-                         }
-
-                         switch( c ) {
-                           case 'I':          // Initialization
-                                              resp = Packet_Init;      break;
-                           case 'P':          // Poll
-                                              resp = Packet_Poll;      break;
-                           case 'R':          // Read
-                                              resp = Packet_Read;      break;
-                           case 'T':          // Write (Transmit)
-                                              resp = Packet_Transmit;  break;
-                           default:           // Unknown - Error
-                                              resp = Packet_Err;
-                                              reading = false;
-                                              break;
-                          }
+    if (tx_pos >= tx_len) {
+        return;                              // Nothing to send
+    }
 
-                        // Completed the header, go into message data mode
-                        //------------------------------------------------
-                        inData = true;
-                    }
-                    break;
+    now = micros();
+    if (tx_pos == 0) {
+        if (tx_de_pin >= 0) {
+            tx_room = cmriNet->availableForWrite();
+            digitalWrite(tx_de_pin, HIGH);
+        }
+        tx_lead = cpElapsed(now, poll_time);
+        if (stats) {
+            stats->record(cpNodeStats::HIST_POLL, tx_lead);
+        }
+    }
+
+    if (DL == 0) {
+        cmriNet->write(TX_Buf + tx_pos, tx_len - tx_pos);
+        if (stats) {
+            stats->count(cpNodeStats::COUNT_BYTES_OUT, tx_len - tx_pos);
+        }
+        tx_pos = tx_len;
+    } else if ((tx_pos == 0) || (cpElapsed(now, tx_time) >= DL)) {
+        cmriNet->write(TX_Buf[tx_pos++]);
+        if (stats) {
+            stats->count(cpNodeStats::COUNT_BYTES_OUT);
+        }
+    } else {
+        return;                              // Not time for the next byte yet
+    }
+    tx_time = now;
+
+    if ((tx_pos >= tx_len) && (tx_de_pin >= 0)) {
+        tx_draining = true;
+        callback_CMRI_Transmit();            // Release right away if it is already gone
+    }
+}
+
+
+// ----------------------------------------------------------------------
+//  Read the message from the Host and determine if the message is
+//  for this node.  The message data, stripped of protocol characters,
+//  is decoded straight into OB or the Init fields as it arrives.
+//
+//  Only the bytes already waiting in the serial port are consumed;
+//  a partially received message is kept in the parser state and
+//  finished on a later call.  Packet_None is returned until a whole
+//  message (or an error) has been seen.
+//
+//  If the node address does not match, the rest of the message is
+//  skipped right here, without buffering or debug output, honoring
+//  DLE escapes so that an escaped ETX in another node's data does not
+//  end the skip early.
+//
+//  The data message body is processed by an appropriate message handler.
+//
+//    - Initialization Packet (I)
+//      SYN SYN STX <UA> <I> <NDP> <dH><dL> <NS> <CT(1)><CT(NS)> ETX
+//
+//    - Poll for Data (P)
+//      SYN SYN STX <UA> <P> ETX
+//
+//    - Read Data (R)
+//      SYN SYN STX <UA> <R> <IB(1)><IB(NS)> ETX
+//----------------------------------------------------------------------
+
+int cpNodeBase::getPacket() {
+    int resp = Packet_None;
+    unsigned int bytes = 0;
 
-        case ETX:   // End of message, read complete
-                    if ((Monitor) && ((debugging) & (DEBUG_PROTOCOL))) { Monitor->print(" ETX "); }
-                    reading = false;
+    if (cmriNet->available() <= 0) {
+        // If the host went quiet in the middle of a message,
+        // give up on it and look for the start of the next one.
+        // Only once the serial port is empty: a slow loop() with
+        // the rest of the message already waiting is not a gap
+        //-----------------------------------------------------
+        if ((rx_timeout) && (rx_state != RX_IDLE) && (cpElapsed(micros(), rx_time) > rx_timeout)) {
+            trace.add(TRACE_TIMEOUT, rx_state);
+            if (stats) {
+                stats->count(cpNodeStats::COUNT_RESYNC);
+            }
+            rx_state = RX_IDLE;
+        }
+        return Packet_None;
+    }
+
+    while ((resp == Packet_None) && (cmriNet->available() > 0)) {
+        byte c = byte(cmriNet->read());
+        bytes++;
+
+        // Fast path for messages addressed to other nodes
+        //------------------------------------------------
+        if (rx_state == RX_SKIP) {
+            skip_bytes++;
+            if (c == ETX) {
+                rx_state = RX_IDLE;
+            } else if (c == DLE) {
+                rx_state = RX_SKIP_DLE;
+            }
+            continue;
+        }
+        if (rx_state == RX_SKIP_DLE) {
+            skip_bytes++;
+            rx_state = RX_SKIP;
+            continue;
+        }
+
+        resp = callback_parse_CMRI_Byte(c);
+    }
+
+    if (stats) {
+        stats->count(cpNodeStats::COUNT_BYTES_IN, bytes);
+    }
+    if (rx_timeout) {
+        rx_time = micros();
+    }
+    return resp;
+}  // getPacket
+
+
+// ----------------------------------------------------------------------
+//  Advance the receive parser by one byte.
+//
+//  Returns Packet_None while a message is still being received
+//  or skipped, otherwise the type of the completed message or Packet_Err.
+//----------------------------------------------------------------------
+int cpNodeBase::callback_parse_CMRI_Byte(byte c) {
+    switch (rx_state) {
+    case RX_IDLE:   // FALLTHROUGH
+    case RX_SYN:    // Hunt for the start of a message
+                    if (c == SYN) {
+                        rx_synced = (rx_state == RX_SYN);
+                        rx_state = RX_SYN;
+                    } else if (c == STX) {
+                        if (rx_state == RX_IDLE) {
+                            rx_synced = false;
+                        }
+                        trace.add(TRACE_STX, c);
+                        rx_state = RX_UA;
+                    } else {
+                        rx_state = RX_IDLE;
+                    }
                     break;
 
-        case DLE:   // Read the next byte regarDLEss of value and store it
-                    CMRInet_Buf[inCnt++] = callback_read_CMRI_Byte();
+    case RX_UA:     // Node Address
+                    trace.add(TRACE_UA, c);
 
-                    if ((Monitor) && ((debugging) & (DEBUG_PROTOCOL))) {
-                        sprintf(debug_buffer, "DLE(0x%02x) ", byte(CMRInet_Buf[inCnt-1]));
-                        Monitor->print(debug_buffer);
+                    if ((rx_synced) && ((byte)(c - UA_Offset) <= 64)) {
+                        rx_frames++;            // the link speed must be right
                     }
 
+                    // If node ID does not match, skip to ETX
+                    //---------------------------------------
+                    rx_node = callback_find_Node(c);
+                    if (rx_node == NULL)  {
+                          trace.add(TRACE_FOREIGN, c);
+                          skip_msgs++;
+                          if (stats) {
+                              stats->count(cpNodeStats::COUNT_FOREIGN);
+                          }
+                          rx_state = RX_SKIP;
+                          return Packet_None;
+                    }
+                    rx_state = RX_TYPE;
                     break;
 
-        case SYN:   // SYNc character Ignore it if not reading data
-                    if (inData) CMRInet_Buf[inCnt++] = c;
-                    if ((Monitor) && ((debugging) & (DEBUG_PROTOCOL))) { Monitor->print(" SYN "); }
+    case RX_TYPE:   // Set response code based upon message type
+                    //------------------------------------------
+                    switch( c ) {
+                      case 'I':     // Initialization
+                                    rx_type = Packet_Init;      break;
+                      case 'P':     // Poll
+                                    rx_type = Packet_Poll;      break;
+                      case 'R':     // Read
+                                    rx_type = Packet_Read;      break;
+                      case 'T':     // Write (Transmit)
+                                    rx_type = Packet_Transmit;  break;
+                      case 'Q':     // Poll, full response
+                                    rx_type = Packet_Query;     break;
+                      default:      // Unknown - Error
+                                    trace.add(TRACE_BAD_TYPE, c);
+                                    if (stats) {
+                                        stats->count(cpNodeStats::COUNT_BAD_TYPE);
+                                    }
+                                    rx_state = RX_FLUSH;
+                                    return Packet_Err;
+                    }
+
+                    trace.add(TRACE_TYPE, c);
+
+                    // Completed the header, go into message data mode
+                    //------------------------------------------------
+                    inCnt = 0;
+                    rx_node->rx_xor = rx_node->invert_out ? 0xFF : 0x00;
+                    rx_state = RX_DATA;
                     break;
 
-        default:    // Stuff the data character into the receive buffer
+    case RX_DATA:   switch (c) {
+                    case ETX:   // End of message, read complete
+                                trace.add(TRACE_ETX, (inCnt > 0xFF) ? 0xFF : inCnt);
+                                rx_state = RX_IDLE;
+                                return rx_type;
 
-                    if ((Monitor) && ((debugging) & (DEBUG_PROTOCOL))) {
-                        sprintf(debug_buffer, "{0x%02x}", byte(c));
-                        Monitor->print(debug_buffer);
+                    case DLE:   // Read the next byte regardless of value
+                                rx_state = RX_DLE;
+                                return Packet_None;
+
+                    default:    // Decode the data character (SYNs included)
+                                trace.add(TRACE_DATA, c);
+                                rx_node->callback_store_CMRI_Byte(rx_type, inCnt++, c);
+                                break;
                     }
+                    break;
 
-                    CMRInet_Buf[inCnt++] = c;
+    case RX_DLE:    // Store the escaped byte
+                    trace.add(TRACE_DLE, c);
+                    rx_node->callback_store_CMRI_Byte(rx_type, inCnt++, c);
+                    rx_state = RX_DATA;
                     break;
-        }
 
-        // Check for buffer overrun and terminate the read if true
-        //--------------------------------------------------------
-        if (inCnt > CMRInet_BufSize) {
-            reading = false;
-            resp = Packet_Err;
+    case RX_FLUSH:  // FALLTHROUGH
+    default:        if (c == ETX) {
+                        rx_state = RX_IDLE;
+                    }
+                    return Packet_None;
+    }
 
-            if ((Monitor) && ((debugging) & (DEBUG_PROTOCOL))) {
-                sprintf(debug_buffer, "\nBuffer Overrun inCnt = %d\n", inCnt);
-                Monitor->print(debug_buffer);
-            }
+    // Give up on a message longer than any the protocol allows
+    //---------------------------------------------------------
+    if (inCnt >= CMRInet_BufSize) {
+        trace.add(TRACE_TOO_LONG, 0xFF);
+        if (stats) {
+            stats->count(cpNodeStats::COUNT_OVERRUN);
         }
+        inCnt = 0;
+        rx_state = RX_FLUSH;
+        return Packet_Err;
+    }
+    return Packet_None;
+}
 
-    } while (reading);
+// ----------------------------------------------------------------------
+//  Decode one (unescaped) data byte of a message of <type> being
+//  received for this node, by its position <pos> in the message.
+//
+//  T message bytes go into OB_rx, inverted if asked; bytes past nOB
+//  are dropped.  They only reach OB, and are only flagged as changed,
+//  once the message's ETX is in (callback_accept_Node_Outputs()), so a
+//  message that is cut short or times out leaves OB alone.
+//
+//  Init message fields are kept until the whole message is in; the
+//  USIC/SUSIC card type table is counted as it goes by, 4 cards per CT
+//  byte, 2 bits each from the low bits up: 01 input, 10 output card.
+// ----------------------------------------------------------------------
+void cpNodeBase::callback_store_CMRI_Byte(byte type, int pos, byte c) {
+    byte k;
 
-    // Null terminate the input buffer
-    //--------------------------------
-    CMRInet_Buf[inCnt] = 0;
+    switch (type) {
+    case Packet_Transmit:
+                    if (pos < nOB) {
+                        OB_rx[pos] = c ^ rx_xor;
+                    }
+                    break;
 
-    //---------------------------------------------------------
-    // Match the node address in the message to the UA+65 value
-    // if no match, ignore message, not addessed to this node
-    //---------------------------------------------------------
+    case Packet_Init:
+                    if (pos == 0) {
+                        init_NDP   = c;
+                        init_opts1 = 0;
+                        init_opts2 = 0;
+                        init_NS    = 0;
+                        init_NIN   = 0;
+                        init_NOUT  = 0;
+                        if (timers) {
+                            timers->beginConfig();
+                        }
+                    } else if (pos == 1) {
+                        init_DL  = c << 8;                      // DLH
+                    } else if (pos == 2) {
+                        init_DL |= c;                           // DLL
+                    } else if (init_NDP == cpNODE_NDP) {
+                        switch (pos) {
+                        case 3:     init_opts1 = c;             break;
+                        case 4:     init_opts2 = c;             break;
+                        case 5:     init_NIN   = c;             break;
+                        case 6:     init_NOUT  = c;             break;
+                        default:    if ((host_config) && (timers)) {
+                                        timers->configure(pos - 7, c);  // staged until the ETX
+                                    }
+                                    break;
+                        }
+                    } else if (pos == 3) {
+                        init_NS = c;
+                    } else if ((pos - 4 < init_NS) && ((init_NDP == USIC_NDP) || (init_NDP == SUSIC_NDP))) {
+                        for (k = 0; k < 8; k += 2) {
+                            switch ((c >> k) & 0x03) {
+                            case 0x01:  init_NIN++;             break;
+                            case 0x02:  init_NOUT++;            break;
+                            default:                            break;
+                            }
+                        }
+                    }
+                    break;
 
-    if ((Monitor) && ((debugging) & (DEBUG_PROTOCOL))) {
-        sprintf(debug_buffer, "\n ->inCnt = %d]n", inCnt);
-        Monitor->print(debug_buffer);
+    default:        // No data expected
+                    break;
     }
-    return resp;
-}  // getPacket
+}
 
 void IOX::init(int i2cAddress, byte port, bool isInput) {
     if (isInput == IOX::IN) {
@@ -502,3 +1497,769 @@ int IOX::read(int i2CAddress, byte port) {
     Wire.requestFrom(i2CAddress,1);               // Data to read
     return Wire.read();
 }
+
+// -----------------------------------------------------------------------
+//  Configure both ports of a device with a single write.
+//
+//  The MCP28017 register map (IOCON.BANK = 0) interleaves the A and B
+//  registers from IODIRA (0x00) up to GPPUB (0x0D), so one sequential
+//  write covers direction, polarity and pullups for both ports; the
+//  interrupt registers in between are set to their power-on defaults,
+//  so enableInterrupts() has to come after it.
+// -----------------------------------------------------------------------
+void IOX::init16(int i2cAddress, bool isInputA, bool isInputB) {
+    byte dirA  = (isInputA == IOX::IN) ? MCP28017_PORT_INPUT     : MCP28017_PORT_OUTPUT;
+    byte dirB  = (isInputB == IOX::IN) ? MCP28017_PORT_INPUT     : MCP28017_PORT_OUTPUT;
+    byte polA  = (isInputA == IOX::IN) ? MCP28017_PORT_ACTIVELOW : 0x00;
+    byte polB  = (isInputB == IOX::IN) ? MCP28017_PORT_ACTIVELOW : 0x00;
+    byte pullA = (isInputA == IOX::IN) ? MCP28017_PORT_PULLUPS   : 0x00;
+    byte pullB = (isInputB == IOX::IN) ? MCP28017_PORT_PULLUPS   : 0x00;
+
+    Wire.beginTransmission(i2cAddress);       // Board Address (20...27)
+    Wire.write(MCP28017_IO);                  // Start at IODIRA
+    Wire.write(dirA);                         // 0x00 IODIRA
+    Wire.write(dirB);                         // 0x01 IODIRB
+    Wire.write(polA);                         // 0x02 IPOLA
+    Wire.write(polB);                         // 0x03 IPOLB
+    for (byte r = 0x04; r < MCP28017_PULLUP; r++) {
+        Wire.write(0x00);                     // 0x04..0x0B GPINTEN, DEFVAL, INTCON, IOCON
+    }
+    Wire.write(pullA);                        // 0x0C GPPUA
+    Wire.write(pullB);                        // 0x0D GPPUB
+    Wire.endTransmission();
+}
+
+void IOX::write16(int i2cAddress, const byte *data) {
+    Wire.beginTransmission(i2cAddress);       // Board Address
+    Wire.write(MCP28017_GPIO);                // GPIOA, then GPIOB
+    Wire.write(data[IOX::PORT_A]);
+    Wire.write(data[IOX::PORT_B]);
+    Wire.endTransmission();
+}
+
+// -----------------------------------------------------------------------
+//  Write only the ports whose output bytes changed, e.g.
+//      iox.update16(0x21, &OB[2], cmri.outputChanged(2), cmri.outputChanged(3));
+//  Both ports go in one transaction, one port in a single port write,
+//  and nothing is sent if neither changed.
+// -----------------------------------------------------------------------
+void IOX::update16(int i2cAddress, const byte *data, bool changedA, bool changedB) {
+    if (changedA && changedB) {
+        write16(i2cAddress, data);
+    } else if (changedA) {
+        write(i2cAddress, IOX::PORT_A, data[IOX::PORT_A]);
+    } else if (changedB) {
+        write(i2cAddress, IOX::PORT_B, data[IOX::PORT_B]);
+    }
+}
+
+void IOX::read16(int i2cAddress, byte *data) {
+    Wire.beginTransmission(i2cAddress);       // Board Address
+    Wire.write(MCP28017_GPIO);                // GPIOA, then GPIOB
+    Wire.endTransmission();
+
+    Wire.requestFrom(i2cAddress, 2);          // Data to read
+    data[IOX::PORT_A] = Wire.read();
+    data[IOX::PORT_B] = Wire.read();
+}
+
+// -----------------------------------------------------------------------
+//  Interrupt on change
+//
+//  Each input bit set in maskA/maskB raises the device's interrupt when it
+//  changes.  INTA and INTB are mirrored and open drain, so the INT pins of
+//  every device can be wired together to one 'duino pin (with a pullup),
+//  and interruptPending() on that pin tells if any input changed at all.
+//  GPINTEN, DEFVAL, INTCON and IOCON are consecutive registers, so this is
+//  a single write.
+// -----------------------------------------------------------------------
+void IOX::enableInterrupts(int i2cAddress, byte maskA, byte maskB) {
+    Wire.beginTransmission(i2cAddress);           // Board Address
+    Wire.write(MCP28017_INTENABLE);               // Start at GPINTENA
+    Wire.write(maskA);                            // 0x04 GPINTENA
+    Wire.write(maskB);                            // 0x05 GPINTENB
+    Wire.write(0x00);                             // 0x06 DEFVALA (unused)
+    Wire.write(0x00);                             // 0x07 DEFVALB
+    Wire.write(0x00);                             // 0x08 INTCONA: interrupt on any change
+    Wire.write(0x00);                             // 0x09 INTCONB
+    Wire.write(MCP28017_IOCON_MIRROR | MCP28017_IOCON_ODR);   // 0x0A IOCON
+    Wire.write(MCP28017_IOCON_MIRROR | MCP28017_IOCON_ODR);   // 0x0B IOCON (same register)
+    Wire.endTransmission();
+}
+
+// -----------------------------------------------------------------------
+//  Update data[PORT_A], data[PORT_B] with the inputs of a device that has
+//  interrupts enabled.  Returns CHANGED if any of them changed, or'ed with
+//  REREAD if the device has to be read again on the next pass whether or
+//  not it interrupts.
+//
+//  INTF, INTCAP and GPIO are consecutive registers and are read in one
+//  transaction, which also clears the interrupt.  A bit that changed
+//  reports the value captured when it changed (INTCAP), and the rest the
+//  current value, so a pulse shorter than the time between two reads is
+//  still reported instead of being missed.  If such a bit has already
+//  gone back (INTCAP differs from GPIO), its return raised no interrupt
+//  of its own, so nothing would ever read the current level: REREAD asks
+//  for that, and the next readChanged() picks it up.
+//
+//  data must keep its contents between calls (it is usually a copy of
+//  the expander inputs kept by the sketch, not IB itself), so devices
+//  that didn't raise an interrupt don't need to be read at all.
+// -----------------------------------------------------------------------
+byte IOX::readChanged(int i2cAddress, byte *data) {
+    byte intf[2], intcap[2], gpio[2];
+    byte p;
+    byte r = 0;
+
+    Wire.beginTransmission(i2cAddress);           // Board Address
+    Wire.write(MCP28017_INTFLAG);                 // INTFA, INTFB, INTCAPA, INTCAPB, GPIOA, GPIOB
+    Wire.endTransmission();
+
+    Wire.requestFrom(i2cAddress, 6);
+    intf[IOX::PORT_A]   = Wire.read();
+    intf[IOX::PORT_B]   = Wire.read();
+    intcap[IOX::PORT_A] = Wire.read();
+    intcap[IOX::PORT_B] = Wire.read();
+    gpio[IOX::PORT_A]   = Wire.read();
+    gpio[IOX::PORT_B]   = Wire.read();
+
+    for (p = IOX::PORT_A; p <= IOX::PORT_B; p++) {
+        data[p] = (gpio[p] & ~intf[p]) | (intcap[p] & intf[p]);
+        if (intf[p]) {
+            r |= CHANGED;
+        }
+        if (intf[p] & (intcap[p] ^ gpio[p])) {
+            r |= REREAD;
+        }
+    }
+    return r;
+}
+
+
+// -----------------------------------------------------------------------
+//  Start the I2C bus.  The MCP28017 supports 400 kHz fast mode.
+// -----------------------------------------------------------------------
+void IOX::begin(unsigned long clock) {
+    Wire.begin();
+    Wire.setClock(clock);
+}
+
+
+IOXQueue::IOXQueue(void) {
+    head = 0;
+    count = 0;
+    max_depth = 0;
+    last_latency = 0;
+    max_latency = 0;
+    completed = 0;
+    errors = 0;
+    last_error = 0;
+}
+
+// -----------------------------------------------------------------------
+//  Add a transaction to the queue; false if the queue is full.
+//
+//  A write to a register that already has a write waiting just replaces
+//  that write's data, so only the latest value goes out.  Only the
+//  newest job touching those registers is looked at: merging past a
+//  later write or read of either port (a write16() then a write() of
+//  PORT_A, say) would reorder them, and leave the older data in place.
+// -----------------------------------------------------------------------
+bool IOXQueue::enqueue(int i2cAddress, byte reg, byte len, bool isRead, const byte *data, byte *dest) {
+    byte i;
+    Job *j;
+
+    if (!isRead) {
+        for (i = count; i > 0; i--) {
+            j = &jobs[(head + i - 1) % QueueSize];
+            if ((j->i2cAddress != i2cAddress) || (j->reg >= reg + len) || (j->reg + j->len <= reg)) {
+                continue;                       // another device, or other registers
+            }
+            if ((!j->isRead) && (j->reg == reg) && (j->len == len)) {
+                memcpy(j->data, data, len);
+                return true;
+            }
+            break;
+        }
+    }
+
+    if (count >= QueueSize) {
+        return false;
+    }
+
+    j = &jobs[(head + count) % QueueSize];
+    j->i2cAddress = i2cAddress;
+    j->reg = reg;
+    j->len = len;
+    j->isRead = isRead;
+    if (data) {
+        memcpy(j->data, data, len);
+    }
+    j->dest = dest;
+    j->queued = micros();
+
+    if (++count > max_depth) {
+        max_depth = count;
+    }
+    return true;
+}
+
+bool IOXQueue::write(int i2cAddress, byte port, byte data) {
+    return enqueue(i2cAddress, IOX::MCP28017_GPIO + port, 1, false, &data, NULL);
+}
+
+bool IOXQueue::write16(int i2cAddress, const byte *data) {
+    return enqueue(i2cAddress, IOX::MCP28017_GPIO, 2, false, data, NULL);
+}
+
+bool IOXQueue::update16(int i2cAddress, const byte *data, bool changedA, bool changedB) {
+    if (changedA && changedB) {
+        return write16(i2cAddress, data);
+    } else if (changedA) {
+        return write(i2cAddress, IOX::PORT_A, data[IOX::PORT_A]);
+    } else if (changedB) {
+        return write(i2cAddress, IOX::PORT_B, data[IOX::PORT_B]);
+    }
+    return true;
+}
+
+bool IOXQueue::read(int i2cAddress, byte port, byte *dest) {
+    return enqueue(i2cAddress, IOX::MCP28017_GPIO + port, 1, true, NULL, dest);
+}
+
+bool IOXQueue::read16(int i2cAddress, byte *dest) {
+    return enqueue(i2cAddress, IOX::MCP28017_GPIO, 2, true, NULL, dest);
+}
+
+// -----------------------------------------------------------------------
+//  Run the transaction at the head of the queue
+// -----------------------------------------------------------------------
+bool IOXQueue::poll(void) {
+    byte i;
+    byte status;
+    Job *j;
+
+    if (count == 0) {
+        return false;
+    }
+    j = &jobs[head];
+
+    Wire.beginTransmission(j->i2cAddress);
+    Wire.write(j->reg);
+    if (!j->isRead) {
+        for (i = 0; i < j->len; i++) {
+            Wire.write(j->data[i]);
+        }
+    }
+    status = Wire.endTransmission();
+
+    if (j->isRead && (status == 0)) {
+        Wire.requestFrom((int)j->i2cAddress, (int)j->len);
+        for (i = 0; i < j->len; i++) {
+            j->dest[i] = Wire.read();
+        }
+    }
+
+    if (status != 0) {
+        errors++;
+        last_error = status;
+    }
+    last_latency = cpElapsed(micros(), j->queued);
+    if (last_latency > max_latency) {
+        max_latency = last_latency;
+    }
+    completed++;
+
+    head = (head + 1) % QueueSize;
+    count--;
+    return count > 0;
+}
+
+void IOXQueue::flush(void) {
+    while (poll()) {
+        ;
+    }
+}
+
+
+IOXBank::IOXBank(void) {
+    nDevices = 0;
+    nIn = 0;
+    nOut = 0;
+}
+
+// -----------------------------------------------------------------------
+//  Add one expander port; false if the port was already added or there
+//  is no room for another device.
+// -----------------------------------------------------------------------
+bool IOXBank::add(int i2cAddress, byte port, bool isInput) {
+    byte i;
+    Device *d = NULL;
+
+    if (port > IOX::PORT_B) {
+        return false;
+    }
+    for (i = 0; i < nDevices; i++) {
+        if (devices[i].i2cAddress == i2cAddress) {
+            d = &devices[i];
+            break;
+        }
+    }
+    if (d == NULL) {
+        if (nDevices >= MaxDevices) {
+            return false;
+        }
+        d = &devices[nDevices++];
+        d->i2cAddress = i2cAddress;
+        d->used = 0;
+        d->input = 0;
+    }
+    if (d->used & (1 << port)) {
+        return false;
+    }
+
+    d->used |= (1 << port);
+    if (isInput == IOX::IN) {
+        d->input |= (1 << port);
+        d->slot[port] = FirstByte + nIn++;
+    } else {
+        d->slot[port] = FirstByte + nOut++;
+    }
+    return true;
+}
+
+bool IOXBank::add16(int i2cAddress, bool isInputA, bool isInputB) {
+    return add(i2cAddress, IOX::PORT_A, isInputA) && add(i2cAddress, IOX::PORT_B, isInputB);
+}
+
+// -----------------------------------------------------------------------
+//  Configure every device, size the node's IB and OB to match, and let
+//  the node read and write the bank from now on.  A port that was not
+//  added is left as an input.  Devices are set up with init16(), so
+//  any enableInterrupts() on them goes after this.
+// -----------------------------------------------------------------------
+void IOXBank::begin(cpNodeBase &node) {
+    byte i;
+
+    for (i = 0; i < nDevices; i++) {
+        Device *d = &devices[i];
+        IOX::init16(d->i2cAddress,
+                    (d->input & (1 << IOX::PORT_A)) || !(d->used & (1 << IOX::PORT_A)),
+                    (d->input & (1 << IOX::PORT_B)) || !(d->used & (1 << IOX::PORT_B)));
+    }
+    node.setNumInputBytes(getNumInputBytes());
+    node.setNumOutputBytes(getNumOutputBytes());
+    node.setIOXBank(this);
+}
+
+// -----------------------------------------------------------------------
+//  Read the input ports into IB.  A device whose two ports are inputs on
+//  consecutive IB bytes is read in one transaction.  With a queue the
+//  reads land in IB later, unless the queue is full.  Ports past the
+//  first len bytes of IB are not read.
+// -----------------------------------------------------------------------
+void IOXBank::read(byte *IB, byte len, IOXQueue *q) {
+    byte i, p;
+
+    for (i = 0; i < nDevices; i++) {
+        Device *d = &devices[i];
+        byte in = d->used & d->input;
+
+        for (p = IOX::PORT_A; p <= IOX::PORT_B; p++) {
+            if ((in & (1 << p)) && (d->slot[p] >= len)) {
+                in &= ~(1 << p);
+            }
+        }
+
+        if ((in == 0x03) && (d->slot[IOX::PORT_B] == d->slot[IOX::PORT_A] + 1)) {
+            if (!q || !q->read16(d->i2cAddress, &IB[d->slot[IOX::PORT_A]])) {
+                IOX::read16(d->i2cAddress, &IB[d->slot[IOX::PORT_A]]);
+            }
+            continue;
+        }
+        for (p = IOX::PORT_A; p <= IOX::PORT_B; p++) {
+            if (in & (1 << p)) {
+                if (!q || !q->read(d->i2cAddress, p, &IB[d->slot[p]])) {
+                    IB[d->slot[p]] = IOX::read(d->i2cAddress, p);
+                }
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------
+//  Write the output ports whose OB bytes are flagged in the changed
+//  bitmap.  A device whose two ports are outputs on consecutive OB bytes
+//  is written in one transaction when both changed.  Ports past the
+//  first len bytes of OB are not written.
+// -----------------------------------------------------------------------
+void IOXBank::write(const byte *OB, byte len, const byte *changed, IOXQueue *q) {
+    byte i, p;
+    bool c[2];
+
+    for (i = 0; i < nDevices; i++) {
+        Device *d = &devices[i];
+        byte out = d->used & ~d->input;
+
+        for (p = IOX::PORT_A; p <= IOX::PORT_B; p++) {
+            if ((out & (1 << p)) && (d->slot[p] >= len)) {
+                out &= ~(1 << p);
+            }
+        }
+
+        for (p = IOX::PORT_A; p <= IOX::PORT_B; p++) {
+            c[p] = (out & (1 << p)) && (changed[d->slot[p] >> 3] & (1 << (d->slot[p] & 7)));
+        }
+
+        if ((out == 0x03) && (d->slot[IOX::PORT_B] == d->slot[IOX::PORT_A] + 1)) {
+            if (!q || !q->update16(d->i2cAddress, &OB[d->slot[IOX::PORT_A]], c[IOX::PORT_A], c[IOX::PORT_B])) {
+                IOX::update16(d->i2cAddress, &OB[d->slot[IOX::PORT_A]], c[IOX::PORT_A], c[IOX::PORT_B]);
+            }
+            continue;
+        }
+        for (p = IOX::PORT_A; p <= IOX::PORT_B; p++) {
+            if (c[p]) {
+                if (!q || !q->write(d->i2cAddress, p, OB[d->slot[p]])) {
+                    IOX::write(d->i2cAddress, p, OB[d->slot[p]]);
+                }
+            }
+        }
+    }
+}
+
+
+// ***************************************************
+// *******    Protocol and timing metrics    *********
+// ***************************************************
+void cpNodeStats::reset(void) {
+    memset(counts, 0, sizeof(counts));
+    memset(hist, 0, sizeof(hist));
+}
+
+// ----------------------------------------------------------
+//  Binary dump, all values little endian:
+//
+//      'S' 'T' <version> <Counters> <Histograms> <Buckets>
+//      <Counters x 4 byte counts, in COUNT_* order>
+//      <Histograms x Buckets x 2 byte counts, in HIST_* order>
+// ----------------------------------------------------------
+void cpNodeStats::dump(Print *port) {
+    byte h, i;
+    unsigned long v;
+
+    port->write('S');
+    port->write('T');
+    port->write(DumpVersion);
+    port->write((byte)Counters);
+    port->write((byte)Histograms);
+    port->write(Buckets);
+    for (i = 0; i < Counters; i++) {
+        v = counts[i];
+        port->write((byte)(v));
+        port->write((byte)(v >> 8));
+        port->write((byte)(v >> 16));
+        port->write((byte)(v >> 24));
+    }
+    for (h = 0; h < Histograms; h++) {
+        for (i = 0; i < Buckets; i++) {
+            port->write((byte)(hist[h][i]));
+            port->write((byte)(hist[h][i] >> 8));
+        }
+    }
+}
+
+
+// ***************************************************
+// *******          Timed outputs            *********
+// ***************************************************
+
+// ----------------------------------------------------------
+//  storage is cpTimedOutputsBase::storageSize(maxOB)
+//  bytes, provided by cpTimedOutputsSized<>
+// ----------------------------------------------------------
+cpTimedOutputsBase::cpTimedOutputsBase(byte maxOB, byte *storage) {
+    byte f;
+
+    this->maxOB = maxOB;
+
+    memset(storage, 0, storageSize(maxOB));
+    callback_point_Modes(storage);  storage += ModeBuffers * maxOB;
+    staged  = storage;              storage += ModeBuffers * maxOB;
+    cmd     = storage;              storage += maxOB;
+    running = storage;              storage += maxOB;
+    cnt0    = storage;              storage += maxOB;
+    cnt1    = storage;              storage += maxOB;
+    cnt2    = storage;              storage += maxOB;
+    out     = storage;
+
+    for (f = 0; f < Flashers; f++) {
+        flash_ms[f] = 0;
+        flash_time[f] = 0;
+    }
+    flash_on = 0;
+    setFlashRate(0, 500);              // about once a second
+    setFlashRate(1, 250);              // fast flash
+    pulse_time = 0;
+    pulsing = false;
+    setPulseLength(100);
+    hold_ms = 0;
+    heard_time = 0;
+    failsafe = false;
+    beginConfig();
+}
+
+// ----------------------------------------------------------
+//  The mode buffers are ModeBuffers * maxOB bytes at <modes>
+// ----------------------------------------------------------
+void cpTimedOutputsBase::callback_point_Modes(byte *modes) {
+    flash   = modes;                modes += maxOB;
+    flash2  = modes;                modes += maxOB;
+    alt     = modes;                modes += maxOB;
+    pulse   = modes;                modes += maxOB;
+    hold    = modes;                modes += maxOB;
+    safe    = modes;
+}
+
+// ----------------------------------------------------------
+//  Set the mode of the <mask> bits of output byte <i>.
+//  A bit flashes, pulses or is steady, and independently
+//  of that may have a safe level (failsafe) or not.
+// ----------------------------------------------------------
+void cpTimedOutputsBase::setMode(byte i, byte mask, byte mode) {
+    callback_set_Mode(flash, i, mask, mode);
+}
+
+// ----------------------------------------------------------
+//  setMode() on the mode buffers at <modes>, the live ones
+//  or those an Init message is staging
+// ----------------------------------------------------------
+void cpTimedOutputsBase::callback_set_Mode(byte *modes, byte i, byte mask, byte mode) {
+    byte *b_flash, *b_flash2, *b_alt, *b_pulse, *b_hold, *b_safe;
+
+    if (i >= maxOB) {
+        return;
+    }
+    b_flash  = &modes[i];
+    b_flash2 = b_flash  + maxOB;
+    b_alt    = b_flash2 + maxOB;
+    b_pulse  = b_alt    + maxOB;
+    b_hold   = b_pulse  + maxOB;
+    b_safe   = b_hold   + maxOB;
+
+    switch (mode) {
+    case MODE_STEADY:       *b_flash &= ~mask;
+                            *b_pulse &= ~mask;
+                            break;
+    case MODE_FLASH:        // FALLTHROUGH
+    case MODE_FLASH_ALT:    // FALLTHROUGH
+    case MODE_FLASH2:       // FALLTHROUGH
+    case MODE_FLASH2_ALT:   *b_flash |= mask;
+                            *b_pulse &= ~mask;
+                            *b_flash2 = ((mode == MODE_FLASH2) || (mode == MODE_FLASH2_ALT)) ? (*b_flash2 | mask) : (*b_flash2 & ~mask);
+                            *b_alt    = ((mode == MODE_FLASH_ALT) || (mode == MODE_FLASH2_ALT)) ? (*b_alt | mask) : (*b_alt & ~mask);
+                            break;
+    case MODE_PULSE:        *b_pulse |= mask;
+                            *b_flash &= ~mask;
+                            break;
+    case MODE_SAFE_OFF:     *b_hold |= mask;
+                            *b_safe &= ~mask;
+                            break;
+    case MODE_SAFE_ON:      *b_hold |= mask;
+                            *b_safe |= mask;
+                            break;
+    case MODE_NO_SAFE:      *b_hold &= ~mask;
+                            *b_safe &= ~mask;
+                            break;
+    default:                break;
+    }
+}
+
+// ----------------------------------------------------------
+//  Each flasher is on for <ms> milliseconds, then off for
+//  as long.  0 stops it where it is.
+// ----------------------------------------------------------
+void cpTimedOutputsBase::setFlashRate(byte flasher, unsigned int ms) {
+    if (flasher < Flashers) {
+        flash_ms[flasher] = ms;
+        flash_time[flasher] = millis() + ms;
+    }
+}
+
+// ----------------------------------------------------------
+//  A pulse lasts 7 or 8 counter ticks, depending on where
+//  in a tick it starts, so the tick is a seventh of the
+//  pulse length, rounded up.
+// ----------------------------------------------------------
+void cpTimedOutputsBase::setPulseLength(unsigned int ms) {
+    pulse_tick = (ms + 6) / 7;
+    if (pulse_tick == 0) {
+        pulse_tick = 1;
+    }
+}
+
+// ----------------------------------------------------------
+//  Timed output settings from a cpNode Init message, after
+//  NOUT; <pos> counts from 0 there.  A 0 leaves the setting
+//  alone:
+//
+//      <FLASH0>    flasher 0 on (and off) time, 10ms units
+//      <FLASH1>    flasher 1 on time, 10ms units
+//      <PULSE>     pulse length, 10ms units
+//      <HOLD>      hold timeout, 100ms units
+//
+//  followed by any number of 3 byte mode records
+//
+//      <OB byte> <MODE_*> <bits>
+//
+//  They are only staged here, between beginConfig() at the
+//  start of the message and applyConfig() at its ETX, so a
+//  message that is cut short changes nothing.
+// ----------------------------------------------------------
+void cpTimedOutputsBase::beginConfig(void) {
+    byte f;
+
+    for (f = 0; f < Flashers; f++) {
+        cfg_flash[f] = 0;
+    }
+    cfg_pulse = 0;
+    cfg_hold = 0;
+    cfg_modes = false;
+    cfg_i = 0;
+    cfg_mode = MODE_STEADY;
+}
+
+void cpTimedOutputsBase::configure(int pos, byte c) {
+    switch (pos) {
+    case 0:         // FALLTHROUGH
+    case 1:         cfg_flash[pos] = c;                             break;
+    case 2:         cfg_pulse = c;                                  break;
+    case 3:         cfg_hold = c;                                   break;
+    default:        if (!cfg_modes) {                               // the records change the modes as they are now
+                        memcpy(staged, flash, ModeBuffers * maxOB);
+                        cfg_modes = true;
+                    }
+                    switch ((pos - 4) % 3) {
+                    case 0:     cfg_i = c;                                          break;
+                    case 1:     cfg_mode = c;                                       break;
+                    default:    callback_set_Mode(staged, cfg_i, c, cfg_mode);      break;
+                    }
+                    break;
+    }
+}
+
+void cpTimedOutputsBase::applyConfig(void) {
+    byte *modes;
+    byte f;
+
+    for (f = 0; f < Flashers; f++) {
+        if (cfg_flash[f]) setFlashRate(f, cfg_flash[f] * 10);
+    }
+    if (cfg_pulse) setPulseLength(cfg_pulse * 10);
+    if (cfg_hold)  setHoldTimeout(cfg_hold * 100UL);
+    if (cfg_modes) {
+        modes = flash;              // swap the staged modes in
+        callback_point_Modes(staged);
+        staged = modes;
+    }
+    beginConfig();
+}
+
+// ----------------------------------------------------------
+//  Work out the outputs from OB (inverted by <inv>), after a
+//  T message (<command>) or when a flasher, pulse tick or
+//  the hold timeout is due, and flag the bytes of the output
+//  image that changed in the <changed> bitmap.  Returns true
+//  if any did; without a T message or anything due, it
+//  returns false right away.
+// ----------------------------------------------------------
+bool cpTimedOutputsBase::run(const byte *OB, byte *changed, byte len, byte inv, bool command) {
+    unsigned long now = millis();
+    bool due = command;
+    bool tick = false;
+    bool fresh = !pulsing;
+    bool any = false;
+    byte lit0, lit1;
+    byte i, f;
+
+    for (f = 0; f < Flashers; f++) {
+        if ((flash_ms[f]) && (cpReached(now, flash_time[f]))) {
+            flash_on ^= (1 << f);
+            flash_time[f] += flash_ms[f];
+            if (cpReached(now, flash_time[f])) {
+                flash_time[f] = now + flash_ms[f];     // fell behind, don't try to catch up
+            }
+            due = true;
+        }
+    }
+    if ((pulsing) && (cpReached(now, pulse_time))) {
+        pulse_time += pulse_tick;
+        if (cpReached(now, pulse_time)) {
+            pulse_time = now + pulse_tick;
+        }
+        tick = true;
+        due = true;
+    }
+    if (command) {
+        failsafe = false;
+    } else if ((hold_ms) && (!failsafe) && (cpElapsed(now, heard_time) >= hold_ms)) {
+        failsafe = true;
+        due = true;
+    }
+    if (!due) {
+        return false;
+    }
+
+    if (len > maxOB) {
+        len = maxOB;
+    }
+    lit0 = (flash_on & 0x01) ? 0xFF : 0x00;
+    lit1 = (flash_on & 0x02) ? 0xFF : 0x00;
+    pulsing = false;
+    for (i = 0; i < len; i++) {
+        byte c, r, carry, lit, o;
+
+        // New pulses start counting from 0, or from 1 when
+        // the tick clock starts with them, so that they all
+        // last 7 to 8 ticks; a pulse ends early if turned off
+        if (command) {
+            c = OB[i] ^ inv;
+            r = c & ~cmd[i] & pulse[i];
+            cnt0[i] = fresh ? (cnt0[i] | r) : (cnt0[i] & ~r);
+            cnt1[i] &= ~r;
+            cnt2[i] &= ~r;
+            running[i] = (running[i] | r) & c;
+            cmd[i] = c;
+        }
+
+        // One tick: count every running lane up, and end
+        // the pulses whose count wraps around
+        if (tick) {
+            r = running[i];
+            carry = cnt0[i] & r;    cnt0[i] ^= r;
+            r = carry;
+            carry = cnt1[i] & r;    cnt1[i] ^= r;
+            r = carry;
+            carry = cnt2[i] & r;    cnt2[i] ^= r;
+            running[i] &= ~carry;
+        }
+        if (running[i]) {
+            pulsing = true;
+        }
+
+        lit = ((flash[i] & ~flash2[i] & lit0) | (flash2[i] & lit1)) ^ (alt[i] & flash[i]);
+        o = cmd[i] & ~((flash[i] & ~lit) | (pulse[i] & ~running[i]));
+        if (failsafe) {
+            o = (o & ~hold[i]) | safe[i];
+        }
+        o ^= inv;
+        if (o != out[i]) {
+            out[i] = o;
+            changed[i >> 3] |= (1 << (i & 7));
+            any = true;
+        }
+    }
+    if ((pulsing) && (fresh)) {
+        pulse_time = now + pulse_tick;
+    }
+    return any;
+}
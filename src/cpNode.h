@@ -49,12 +49,142 @@ extern "C" {
     void unpack(byte *OB, int len);
 }
 
-class cpNode {
+class IOXQueue;
+class IOXBank;
+class cpNodeStats;
+class cpTimedOutputsBase;
+
+// --------------------------------------------------------------------------
+//  micros() and millis() wrap around at 32 bits, every 71 minutes and every
+//  49.7 days.  Times are compared through these, modulo 2^32, so that they
+//  keep working across the wrap even where unsigned long is wider than 32
+//  bits, as it is in the native host build.
+// --------------------------------------------------------------------------
+inline unsigned long cpElapsed(unsigned long now, unsigned long then)  { return (uint32_t)(now - then); }
+inline bool cpReached(unsigned long now, unsigned long when)           { return (int32_t)(now - when) >= 0; }
+
+// --------------------------------------------------------------------------
+//  Protocol tracing
+//
+//  With CPNODE_TRACE set to 1 for the whole build (the library is compiled
+//  on its own, so a #define in the sketch is not enough: use the build flags,
+//  -DCPNODE_TRACE=1, or change the default below), the receive parser logs
+//  each byte it sees as a small binary event in a ring buffer of
+//  CPNODE_TRACE_SIZE events.  proceess() prints them on the debug port
+//  later, once the frame is done and the bus is quiet, so tracing does not
+//  hold up the parser.  With CPNODE_TRACE 0, the default, the trace points
+//  compile to nothing.
+// --------------------------------------------------------------------------
+#ifndef CPNODE_TRACE
+#define CPNODE_TRACE 0
+#endif
+#ifndef CPNODE_TRACE_SIZE
+#define CPNODE_TRACE_SIZE 32
+#endif
+
+template<bool Enabled, byte Size = CPNODE_TRACE_SIZE>
+class cpNodeTrace {
+    static_assert((Size > 0) && (Size <= 128) && ((Size & (Size - 1)) == 0),
+                  "CPNODE_TRACE_SIZE must be a power of 2, up to 128");
+public:
+    struct Event {
+        byte type;                  // TRACE_*
+        byte data;                  // the byte received, or a count
+        unsigned int time;          // micros() when logged, low 16 bits
+    };
+
+    cpNodeTrace(void) : head(0), count(0), dropped(0), last(0) { }
+
+    void add(byte type, byte data) {
+        if (count < Size) {
+            Event *e = &events[(head + count) & (Size - 1)];
+            e->type = type;
+            e->data = data;
+            e->time = (unsigned int)micros();
+            count++;
+        } else if (dropped < 0xFF) {
+            dropped++;
+        }
+    }
+
+    bool pending(void)                          { return (count > 0) || (dropped > 0); }
+    byte takeDropped(void)                      { byte d = dropped; dropped = 0; return d; }
+
+    // Oldest event, and the microseconds since the one before it
+    bool next(Event &e, unsigned int &delta) {
+        if (count == 0) {
+            return false;
+        }
+        e = events[head];
+        head = (head + 1) & (Size - 1);
+        count--;
+        delta = e.time - last;
+        last = e.time;
+        return true;
+    }
+
+private:
+    Event events[Size];
+    byte head;                      // oldest event
+    byte count;                     // events waiting to be printed
+    byte dropped;                   // events lost because the buffer was full
+    unsigned int last;              // time of the last event printed
+};
+
+template<byte Size>
+class cpNodeTrace<false, Size> {
+public:
+    struct Event {
+        byte type;
+        byte data;
+        unsigned int time;
+    };
+
+    void add(byte, byte)                        { }
+    bool pending(void)                          { return false; }
+    byte takeDropped(void)                      { return 0; }
+    bool next(Event &, unsigned int &)          { return false; }
+};
+
+// --------------------------------------------------------------------------
+//  The protocol handler.  The buffers it works with are sized at compile
+//  time by cpNodeSized<> (below), which is what a sketch declares; cpNode
+//  is the standard size.
+// --------------------------------------------------------------------------
+class cpNodeBase {
+public:
+    //-------------------------
+    // Standard buffer capacity
+    //-------------------------
+    static const int CMRInet_BufSize  = 260;           //  Longest message body accepted: Max SUSIC + 4 pad
+    static const int IO_bufsize       = (2 + 16) + 4;  //  cpNode (2) + IOX Ports (8x2=16) + pad (Max expected for a cpNode)
+
+    // Poll response: SYN SYN STX UA R + every IB byte DLE escaped + ETX
+    static constexpr int txBufSize(int maxIB)   { return 5 + (2 * maxIB) + 1; }
+
+    // Bytes of buffer space needed for a node of a given capacity
+    static constexpr int storageSize(int maxIB, int maxOB) {
+        return txBufSize(maxIB)
+             + (8 * maxIB)                      // IB_last, IB_A, IB_B, db_state, db_cnt0/1/2, db_mask
+             + (2 * maxOB) + ((maxOB + 7) / 8); // OB, OB_rx, OB_changed
+    }
+
+    //------------------------------------------------------------
+    // cpNode Init message option bits (opts1), see setHostConfig()
+    //------------------------------------------------------------
+    enum {
+        OPT_NO_TX_PACING     = 0x01,   // ignore DL, send poll responses at full speed
+        OPT_UNPACK_ON_CHANGE = 0x02,   // setUnpackOnChange(true)
+        OPT_INVERT_INPUTS    = 0x04,   // invertInputs(true)
+        OPT_INVERT_OUTPUTS   = 0x08,   // invertOutputs(true)
+        OPT_CLEAR_OUTPUTS    = 0x10,   // turn all outputs off when initialized
+        OPT_REPORT_CHANGES   = 0x20,   // setReportChanges(true)
+    };
+
 protected:
     // Library debugging ...
     enum {
         DEBUG_ANNOUNCE = 0x01,    // print config info at end of setup...
-        DEBUG_PROTOCOL = 0x02,
         DEBUG_POLL     = 0x04,
         DEBUG_INIT     = 0x08,
     };
@@ -63,19 +193,19 @@ protected:
     //--------------------
     // Protocol characters
     //--------------------
-    static const char
+    static const byte
                STX    = 0x02,
                ETX    = 0x03,
                DLE    = 0x10,
                SYN    = 0xFF;
 
-    //-------------
-    // Data buffers
-    //-------------
-    static const int CMRInet_BufSize  = 260;           //  Max SUSIC + 4 pad
-    static const int IO_bufsize       = (2 + 16) + 4;  //  cpNode (2) + IOX Ports (8x2=16) + pad (Max expected for a cpNode)
+    static const byte BaudRateCount = 7;
+    static const unsigned long BaudRates[BaudRateCount];   // Link speeds selectable by the host, Init opts2 = 1..
 
     static const char cpNODE_NDP = 'C';     // Node Definition Parameter for a cpNode - Control Point Node
+    static const char SMINI_NDP  = 'M';     //   ... SMINI: 24 inputs, 48 outputs
+    static const char USIC_NDP   = 'N';     //   ... USIC:  24 bit cards
+    static const char SUSIC_NDP  = 'X';     //   ... SUSIC: 32 bit cards
     static const byte UA_Offset  = 'A';     // Decimal 65, Hex 0x41 per CMRI protocol spec
 
     // Read responses
@@ -87,57 +217,257 @@ protected:
                Packet_Init    = 3,  //  "I" Message
                Packet_Poll    = 4,  //  "P" Message
                Packet_Read    = 5,  //  "R" Message
-               Packet_Transmit= 6;  //  "T" Message
-public:
-    cpNode(void);
+               Packet_Transmit= 6,  //  "T" Message
+               Packet_Query   = 7;  //  "Q" Message, poll for a full R response
+
+    // Receive parser states
+    //----------------------
+    enum {
+        RX_IDLE  = 0,   // Hunting for the start of a message
+        RX_SYN,         // SYN seen, waiting for STX
+        RX_UA,          // STX seen, next byte is the node address
+        RX_TYPE,        // Next byte is the message type
+        RX_DATA,        // Message body, until ETX
+        RX_DLE,         // DLE seen, next byte is data regardless of value
+        RX_FLUSH,       // Discarding everything up to the next ETX
+        RX_SKIP,        // Skipping a message for another node, until an unescaped ETX
+        RX_SKIP_DLE,    // Skipping, DLE seen, next byte is not an ETX
+    };
+
+    // Trace events, see CPNODE_TRACE
+    //-------------------------------
+    enum {
+        TRACE_STX = 0,      // Start of a message
+        TRACE_UA,           // Node address
+        TRACE_FOREIGN,      // ... not ours, skipped
+        TRACE_TYPE,         // Message type
+        TRACE_BAD_TYPE,     // ... unknown, flushed
+        TRACE_DATA,         // Data byte
+        TRACE_DLE,          // DLE escaped data byte
+        TRACE_ETX,          // End of message, with the data byte count
+        TRACE_TOO_LONG,     // Message abandoned, longer than CMRInet_BufSize
+        TRACE_TIMEOUT,      // Message abandoned, the host went quiet
+    };
+    static const byte TraceDrainMax = 8;    // events printed per pass through proceess()
+
+    // Link speed states
+    //------------------
+    enum {
+        BAUD_LOCKED = 0,    // Running at a rate that is known to work
+        BAUD_TRIAL,         // Switched at the host's request, back to baud_prev unless a message shows up
+        BAUD_HUNT,          // Looking for the host's rate, trying each in turn
+    };
+
+    cpNodeBase(byte maxIB, byte maxOB, byte *storage);
 
+public:
     void setCMRIPort(Stream *port)              { cmriNet = port; }
     void setDebugPort(Stream *port)             { Monitor = port; }
     byte setNodeAddress(byte nodeAddr);
     byte getNodeAddress(void)                   { return UA - UA_Offset; }
     void invertInputs(bool i)                   { invert_in = i; }
     void invertOutputs(bool i)                  { invert_out = i; }
-    void setNumInputBytes(byte numInputBytes)   { nIB = numInputBytes; }
+    byte setNumInputBytes(byte numInputBytes)   { nIB = (numInputBytes > maxIB) ? maxIB : numInputBytes;    tx_valid = false; report_full = true; return nIB; }
     byte getNumInputBytes(void)                 { return nIB; }
-    void setNumOutputBytes(byte numOutputBytes) { nOB = numOutputBytes; }
+    byte getMaxInputBytes(void)                 { return maxIB; }
+    byte setNumOutputBytes(byte numOutputBytes) { nOB = (numOutputBytes > maxOB) ? maxOB : numOutputBytes; ob_valid = false; return nOB; }
     byte getNumOutputBytes(void)                { return nOB; }
+    byte getMaxOutputBytes(void)                { return maxOB; }
     unsigned long getTXDelay(void)              { return DL; }
+    void setRXTimeout(unsigned long usec)       { rx_timeout = usec; }
+    unsigned long getForeignMessages(void)      { return skip_msgs; }
+    unsigned long getForeignBytes(void)         { return skip_bytes; }
+    bool isTransmitting(void)                   { return (tx_pos < tx_len) || tx_draining; }
+    void setTXEnablePin(int pin);
+    unsigned long getTXEnableDelay(void)        { return tx_lead; }
+    unsigned long getTXReleaseDelay(void)       { return tx_tail; }
+    void setInputSamplePeriod(unsigned long usec);
+    bool setDebounce(byte samples, unsigned long usec);
+    void setDebounceMask(byte i, byte mask)     { if (i < maxIB) db_mask[i] = mask; }
+    void setUnpackOnChange(bool c)              { unpack_on_change = c; }
+    bool outputChanged(byte i)                  { return (i < maxOB) && (OB_changed[i >> 3] & (1 << (i & 7))); }
+    void setIOXQueue(IOXQueue *q)               { iox_queue = q; }
+    void setIOXBank(IOXBank *b)                 { iox_bank = b; }
+    void setStats(cpNodeStats *s)               { stats = s; }
+    bool setTimedOutputs(cpTimedOutputsBase *t);
+    void dumpStats(void);
+    void setHostConfig(bool h)                  { host_config = h; }
+    void setReportChanges(bool c, byte fullEvery = 16)  { report_changes = c; report_every = fullEvery; report_full = true; }
+    void setPackHandler(  void (*fn)(byte *IB, int len))  { pack_fn = fn; }
+    void setUnpackHandler(void (*fn)(byte *OB, int len))  { unpack_fn = fn; }
+    bool addNode(cpNodeBase &node);
+    void setBaudHandler(void (*fn)(unsigned long baud), unsigned long baud, unsigned long timeoutMs = 2000);
+    void autoBaud(void);
+    unsigned long getBaud(void)                 { return baud; }
+    bool isBaudLocked(void)                     { return baud_state == BAUD_LOCKED; }
     void proceess(void);
 
 private:
 
     void callback_pack_Node_Inputs(void);
+    void callback_read_Node_Inputs(byte *buf);
+    void callback_latch_Node_Inputs(byte *buf);
+    void callback_debounce_Node_Inputs(byte *buf);
+    void callback_accept_Node_Outputs(int len);
     void callback_unpack_Node_Outputs(void) ;
+    void callback_write_Node_Outputs(void);
+    void callback_run_Output_Timers(void);
     void callback_process_cpNode_Options(void);
     void callback_initialize_cpNode(void);
     void callback_flush_CMRInet_to_ETX(void) ;
+    void callback_store_CMRI_Byte(byte type, int pos, byte c);
     void callback_CMRI_Poll_Response(void);
-    char callback_read_CMRI_Byte();
+    void callback_CMRI_Transmit(void);
+    void callback_update_Poll_Response(byte from);
+    void callback_sample_Node_Inputs(void);
+    void callback_update_Address_Mask(void);
+    cpNodeBase *callback_find_Node(byte ua);
+    bool callback_bus_Transmitting(void);
+    void callback_set_Baud(unsigned long rate);
+    void callback_check_Baud(void);
+    void callback_drain_Trace(void);
+    bool callback_change_Poll_Response(void);
+    byte callback_encode_CMRI_Byte(byte pos, byte c);
+
+    // Protocol characters that must be DLE escaped in message data,
+    // as a bitmask indexed by character value (all are < 0x20)
+    static const unsigned long DLE_Escaped = (1UL << STX) | (1UL << ETX) | (1UL << DLE);
+    static bool needsDLE(byte c)                { return (c < 0x20) && (DLE_Escaped & (1UL << c)); }
+    int  callback_parse_CMRI_Byte(byte c);
     int getPacket(void);
 
 
 private:
     Stream *cmriNet;          // protocol...
     Stream *Monitor;          // debugging (optional, if not NULL...)
-    char debug_buffer[128];
+    char debug_buffer[64];
+    cpNodeTrace<CPNODE_TRACE> trace;        // Parser events waiting to be printed, empty unless CPNODE_TRACE
 
     int  invert_in;           // for inputs:  CMRI_ACTIVE_LOW or CMRI_ACTIVE_HIGH
     int  invert_out;          // for outputs: CMRI_ACTIVE_LOW or CMRI_ACTIVE_HIGH
 
     byte UA;                  // Node address, stored as UA + UA_Offset
+    byte ua_mask[128 / 8];    // Addresses answered by this node and its added nodes, bit per (UA - UA_Offset)
+    cpNodeBase *next_node;    // Next node added to the same primary node
+    cpNodeBase *primary;      // The node this one was added to, NULL if it runs the protocol itself
+    cpNodeBase *rx_node;      // Node the message being received is for
+    cpNodeBase *poll_node;    // Node with a poll to answer once the bus is free, NULL if none
+    void (*pack_fn)(  byte *IB, int len);   // Input and output handlers, pack() and unpack() by default
+    void (*unpack_fn)(byte *OB, int len);
     unsigned long DL;         // Transmit character delay value in 10 us increments
 
     byte nIB;                 //  Total configured onboard input bytes
     byte nOB;                 //  Total configured onboard output bytes
+    byte maxIB;               //  Capacity of the input buffers
+    byte maxOB;               //  Capacity of the output buffers
+
+    byte rx_state;            // Receive parser state, kept between calls to proceess()
+    byte rx_type;             // Packet_* type of the message being received
+    int  inCnt;               // Data bytes received so far in the current message
+    byte rx_xor;              // Applied to T message bytes on their way into OB (output inversion)
+    char init_NDP;            // Init message fields, decoded as they arrive
+    unsigned int init_DL;
+    byte init_opts1;          //   cpNode option bits
+    byte init_opts2;          //   cpNode: link speed, BaudRates[opts2 - 1], 0 = keep the current one
+    byte init_NS;             //   SMINI, USIC, SUSIC: number of CT bytes
+    byte init_NIN;            //   cpNode: input bytes,  USIC/SUSIC: input cards
+    byte init_NOUT;           //   cpNode: output bytes, USIC/SUSIC: output cards
+    bool host_config;         // Let the Init message set the I/O size and options
+    unsigned long rx_time;    // micros() when the last byte was received
+    unsigned long rx_timeout; // Inter-byte timeout in microseconds (0 = none)
+    unsigned long skip_msgs;  // Messages seen that were addressed to other nodes
+    unsigned long skip_bytes; // Bytes skipped in those messages
+    bool rx_synced;           // The message being received started with SYN SYN STX
+    unsigned int rx_frames;   // Message headers seen (SYN SYN STX and a node address), for any node
+
+    void (*baud_fn)(unsigned long baud);    // Reopens the CMRI port at a new rate, NULL if not allowed
+    unsigned long baud;       // Current link speed
+    unsigned long baud_prev;  // Speed to go back to if a trial fails
+    unsigned long baud_next;  // Speed the host asked for, set once the bus is quiet (0 = none)
+    unsigned long baud_time;  // millis() when the current speed was set
+    unsigned long baud_timeout;   // How long to wait for a message at a new speed, in milliseconds
+    unsigned int baud_frames; // rx_frames when the current speed was set
+    byte baud_state;          // BAUD_*
+    byte baud_try;            // Next entry of BaudRates[] to try while hunting
+
+    byte tx_len;              // Length of the response staged in TX_Buf
+    byte tx_pos;              // Next byte of TX_Buf to send, done when == tx_len
+    unsigned long tx_time;    // micros() when the last paced byte was sent
+    bool tx_valid;            // TX_Buf holds an encoded R message for UA, nIB and IB_last
+
+    bool report_changes;      // Answer polls with C (change of state) messages
+    bool report_full;         // Next poll gets a full R message
+    byte report_every;        // Full R message at least every this many polls (0 = only on request)
+    byte report_count;        // C messages sent since the last R
+
+    int  tx_de_pin;           // RS485 driver enable (DE/RE) pin, -1 if not used
+    bool tx_draining;         // All bytes written, waiting for the UART to finish before releasing DE
+    int  tx_room;             // availableForWrite() of the idle serial port
+    unsigned long poll_time;  // micros() when the poll being answered was received
+    unsigned long tx_lead;    // Poll received to driver enabled and first byte sent, microseconds
+    unsigned long tx_tail;    // Last byte written to driver released, microseconds
+
+    unsigned long sample_period;  // Background input sampling period in microseconds (0 = pack() on poll)
+    unsigned long sample_time;    // micros() of the last background sample
+    bool ib_fresh;            // IB_back holds a sample newer than IB
+    bool sample_busy;         // pack() has queued expander reads into IB_back that haven't finished
+
+    IOXQueue *iox_queue;      // Queued expander transactions, run a step at a time from proceess()
+    IOXBank  *iox_bank;       // Expander ports read and written by the library, after pack() / unpack()
+    cpNodeStats *stats;       // Protocol counters and timing histograms, NULL if not kept
+    cpTimedOutputsBase *timers;   // Flashers, pulses and failsafe applied to OB, NULL if none
+
+    byte db_samples;          // Consecutive samples needed to accept an input change (0 = no debounce)
+    bool db_primed;           // db_state holds the first sample
+
+    bool ob_valid;            // OB holds outputs already passed to unpack()
+    bool unpack_on_change;    // Only call unpack() when an output byte changed
+
+    // Buffers, carved out of the storage given to the constructor
+    byte *TX_Buf;                        // [txBufSize] Poll response, encoded and ready to send
+    byte *IB_last;                       // [maxIB]     Input bits encoded in TX_Buf
+    byte *OB;                            // [maxOB]     Output bits  HOST to NODE, from the last complete T message
+    byte *OB_rx;                         // [maxOB]     T message being received, copied to OB at its ETX
+    byte *OB_changed;                    // [maxOB/8]   Bitmap of OB bytes changed since the last unpack()
+    byte *IB;                            // [maxIB]     Input bits   NODE to HOST
+    byte *IB_back;                       // [maxIB]     Background input sample, swapped with IB on poll
+
+    // Debouncer: one bit lane per input, with a 3 bit vertical counter per lane
+    byte *db_state;                      // [maxIB]     Debounced inputs
+    byte *db_cnt0;                       // [maxIB]     Counter bit 0 for each lane
+    byte *db_cnt1;                       // [maxIB]     Counter bit 1
+    byte *db_cnt2;                       // [maxIB]     Counter bit 2
+    byte *db_mask;                       // [maxIB]     1 = debounce this bit, 0 = pass it through
+};
+
 
-    byte CMRInet_Buf[CMRInet_BufSize];   // CMRI message buffer
-    byte OB[IO_bufsize];                 // Output bits  HOST to NODE
-    byte IB[IO_bufsize];                 // Input bits   NODE to HOST
+// --------------------------------------------------------------------------
+//  A node with room for up to MaxIB input bytes and MaxOB output bytes.
+//
+//      cpNode cmri;                        // standard: 22 in, 22 out
+//      cpNodeSized<2, 2> cmri;             // ProMini with onboard I/O only
+//      cpNodeSized<64, 64> cmri;           // Mega with lots of expanders
+//
+//  setNumInputBytes() and setNumOutputBytes() are limited to the capacity.
+// --------------------------------------------------------------------------
+template<byte MaxIB   = cpNodeBase::IO_bufsize,
+         byte MaxOB   = cpNodeBase::IO_bufsize>
+class cpNodeSized : public cpNodeBase {
+    static_assert((MaxIB > 0) && (cpNodeBase::txBufSize(MaxIB) <= 255), "MaxIB must be 1..124");
+    static_assert((MaxOB > 0) && (MaxOB <= 255), "MaxOB must be 1..255");
+public:
+    cpNodeSized(void) : cpNodeBase(MaxIB, MaxOB, storage) { }
+
+private:
+    byte storage[cpNodeBase::storageSize(MaxIB, MaxOB)];
 };
 
+typedef cpNodeSized<> cpNode;
+
 
 
 class IOX {
+    friend class IOXQueue;
 private:
     //**********************************************************************
     //**********      I2C I/O Expander Support for MCP28017       **********
@@ -146,9 +476,16 @@ private:
     // MCP28017 Register Map
     const static int MCP28017_IO              = 0x00;  // Port A, Port B = 0x01
     const static int MCP28017_ACTIVELOW       = 0x02;  // Port A, Port B = 0x03
+    const static int MCP28017_INTENABLE       = 0x04;  // Port A, Port B = 0x05
     const static int MCP28017_PULLUP          = 0x0C;  // Port A, Port B = 0x0D
+    const static int MCP28017_INTFLAG         = 0x0E;  // Port A, Port B = 0x0F
+    const static int MCP28017_INTCAPTURE      = 0x10;  // Port A, Port B = 0x11
     const static int MCP28017_GPIO            = 0x12;  // Port A, Port B = 0x13
 
+    // ... IOCON bits
+    const static int MCP28017_IOCON_MIRROR    = 0x40;  // INTA and INTB are one interrupt
+    const static int MCP28017_IOCON_ODR       = 0x04;  // INT pins are open drain, so several devices can share a line
+
     // ... Per-Port config register initialization values
     const static int MCP28017_PORT_OUTPUT     = 0x00;
     const static int MCP28017_PORT_INPUT      = 0xFF;
@@ -162,7 +499,339 @@ public:
     const static int PORT_A  = 0;
     const static int PORT_B  = 1;
 
+    static void begin(unsigned long clock = 100000);    // Wire.begin(), 100000 or 400000 Hz
     static void init( int i2cAddress, byte port, bool isInput);
     static void write(int i2CAddress, byte port, byte data);
     static int  read( int i2CAddress, byte port);
+
+    // Both ports of a device in one I2C transaction, using the MCP28017's
+    // sequential addressing: data[0] is PORT_A, data[1] is PORT_B.
+    // init16() also turns interrupt on change off: call it first, then
+    // enableInterrupts()
+    static void init16( int i2cAddress, bool isInputA, bool isInputB);
+    static void write16(int i2cAddress, const byte *data);
+    static void read16( int i2cAddress, byte *data);
+    static void update16(int i2cAddress, const byte *data, bool changedA, bool changedB);
+
+    // Interrupt on change: only read the devices whose inputs changed.
+    // The sketch watches the INT pin; cpNode doesn't.
+    const static byte CHANGED = 0x01;   // readChanged(): some input changed
+    const static byte REREAD  = 0x02;   //   ... and one already changed back, read again next time
+    static void enableInterrupts(int i2cAddress, byte maskA, byte maskB);
+    static bool interruptPending(int intPin)    { return digitalRead(intPin) == LOW; }
+    static byte readChanged(int i2cAddress, byte *data);
 };
+
+
+// --------------------------------------------------------------------------
+//  Queued IOX transactions
+//
+//  Instead of waiting for each I2C transfer, reads and writes are queued and
+//  run one transaction per call to poll(); when attached to a cpNode with
+//  setIOXQueue(), proceess() does that on every pass, so a long run of
+//  expander writes no longer holds up the CMRI parser.  Reads store their
+//  result straight into the given destination, typically the IB slot.
+// --------------------------------------------------------------------------
+class IOXQueue {
+public:
+    static const byte QueueSize = 8;
+
+    IOXQueue(void);
+
+    bool write(  int i2cAddress, byte port, byte data);
+    bool write16(int i2cAddress, const byte *data);
+    bool update16(int i2cAddress, const byte *data, bool changedA, bool changedB);
+    bool read(   int i2cAddress, byte port, byte *dest);
+    bool read16( int i2cAddress, byte *dest);
+
+    bool poll(void);                                // run the next transaction, true if more remain
+    void flush(void);                               // run everything queued, now
+    byte pending(void)                          { return count; }
+
+    byte getMaxDepth(void)                      { return max_depth; }
+    unsigned long getLastLatency(void)          { return last_latency; }
+    unsigned long getMaxLatency(void)           { return max_latency; }
+    unsigned int  getCompleted(void)            { return completed; }
+    unsigned int  getErrors(void)               { return errors; }
+    byte getLastError(void)                     { return last_error; }
+
+private:
+    struct Job {
+        byte i2cAddress;
+        byte reg;                   // first MCP28017 register
+        byte len;                   // 1 or 2 bytes
+        bool isRead;
+        byte data[2];               // bytes to write
+        byte *dest;                 // where read bytes go
+        unsigned long queued;       // micros() when queued
+    };
+
+    bool enqueue(int i2cAddress, byte reg, byte len, bool isRead, const byte *data, byte *dest);
+
+    Job  jobs[QueueSize];
+    byte head;                      // next job to run
+    byte count;                     // jobs waiting
+
+    byte max_depth;                 // most jobs ever waiting at once
+    unsigned long last_latency;     // queued to completed, microseconds
+    unsigned long max_latency;
+    unsigned int  completed;
+    unsigned int  errors;           // transactions not ACKed
+    byte last_error;                // Wire.endTransmission() status
+};
+
+
+// --------------------------------------------------------------------------
+//  Declarative IOX banks
+//
+//  Instead of keeping setNumInputBytes(), setup(), pack() and unpack() in
+//  step by hand, list the expander ports once:
+//
+//      bank.add(0x20, IOX::PORT_A, IOX::IN);       // IB[2]
+//      bank.add(0x20, IOX::PORT_B, IOX::IN);       // IB[3]
+//      bank.add16(0x21, IOX::OUT, IOX::OUT);       // OB[2], OB[3]
+//      bank.begin(cmri);
+//
+//  Input and output ports are given IB and OB bytes in the order they are
+//  added, after the two onboard bytes that are still handled by pack() and
+//  unpack().  begin() configures every device in one transaction each, sets
+//  the node's input and output byte counts and attaches the bank to the
+//  node, which then reads and writes the expander bytes itself, both ports
+//  of a device in one transaction, through the node's IOXQueue if it has one.
+// --------------------------------------------------------------------------
+class IOXBank {
+public:
+    static const byte MaxDevices = 8;               // 0x20..0x27
+    static const byte FirstByte  = 2;               // IB[0], IB[1], OB[0], OB[1] are onboard
+
+    IOXBank(void);
+
+    bool add(  int i2cAddress, byte port, bool isInput);
+    bool add16(int i2cAddress, bool isInputA, bool isInputB);
+    void begin(cpNodeBase &node);
+
+    byte getNumInputBytes(void)                 { return FirstByte + nIn; }
+    byte getNumOutputBytes(void)                { return FirstByte + nOut; }
+
+    void read( byte *IB, byte len, IOXQueue *q);
+    void write(const byte *OB, byte len, const byte *changed, IOXQueue *q);
+
+private:
+    struct Device {
+        byte i2cAddress;
+        byte used;                  // bit per port: port has been added
+        byte input;                 // bit per port: port is an input
+        byte slot[2];               // IB or OB byte for PORT_A, PORT_B
+    };
+
+    Device devices[MaxDevices];
+    byte nDevices;
+    byte nIn;                       // expander input bytes
+    byte nOut;                      // expander output bytes
+};
+
+
+// --------------------------------------------------------------------------
+//  Protocol and timing metrics
+//
+//  Attach one to a node with setStats() and it counts the frames the node
+//  sees, by type, the ones for other nodes, framing errors, resyncs and the
+//  bytes in and out, and keeps log2 histograms of how long things take:
+//
+//      cpNodeStats stats;
+//      cmri.setStats(&stats);
+//      ...
+//      stats.getCount(cpNodeStats::COUNT_POLL);
+//      stats.getHistogram(cpNodeStats::HIST_POLL, 3);      // polls answered in 4..7us
+//      cmri.dumpStats();                                   // binary dump to the debug port
+//
+//  Bucket b of a histogram counts the times of b significant bits, so
+//  bucket 0 is 0us, 1 is 1us, 2 is 2-3us, 3 is 4-7us ... and the last one
+//  is everything from 16.384ms up.  Histogram counts stop at 65535.
+//  Recording is a few increments and a micros() call or two per frame,
+//  so it can be left on.  Nodes added with addNode() keep their own pack,
+//  unpack and poll timings, if given a cpNodeStats of their own.
+// --------------------------------------------------------------------------
+class cpNodeStats {
+public:
+    enum {                          // Counters
+        COUNT_INIT      = 0,        // I frames for this node
+        COUNT_POLL,                 // P frames
+        COUNT_READ,                 // R frames carrying this node's address
+        COUNT_TRANSMIT,             // T frames
+        COUNT_QUERY,                // Q frames
+        COUNT_FOREIGN,              // Frames addressed to other nodes
+        COUNT_BAD_TYPE,             // Frames of an unknown type
+        COUNT_OVERRUN,              // Frames longer than CMRInet_BufSize
+        COUNT_RESYNC,               // Frames abandoned by the RX timeout
+        COUNT_BYTES_IN,
+        COUNT_BYTES_OUT,
+        Counters
+    };
+    enum {                          // Histograms
+        HIST_POLL       = 0,        // Poll received to first response byte sent
+        HIST_PACK,                  // pack(), and any IOXBank reads
+        HIST_UNPACK,                // unpack(), and any IOXBank writes
+        HIST_LOOP,                  // One pass through proceess()
+        Histograms
+    };
+    static const byte Buckets = 16;
+    static const byte DumpVersion = 1;
+
+    cpNodeStats(void)                           { reset(); }
+    void reset(void);
+
+    unsigned long getCount(byte c)              { return (c < Counters) ? counts[c] : 0; }
+    unsigned int  getHistogram(byte h, byte b)  { return ((h < Histograms) && (b < Buckets)) ? hist[h][b] : 0; }
+    void dump(Print *port);
+
+    void count(byte c)                          { counts[c]++; }
+    void count(byte c, unsigned int n)          { counts[c] += n; }
+    void record(byte h, unsigned long usec) {
+        unsigned int *b = &hist[h][bucket(usec)];
+        if (*b != 0xFFFF) {
+            (*b)++;
+        }
+    }
+
+    static byte bucket(unsigned long usec) {
+        byte b = 0;
+        if (usec >= (1UL << (Buckets - 2))) {
+            return Buckets - 1;
+        }
+        unsigned int v = usec;
+        if (v & 0xFF00) {
+            b = 8;
+            v >>= 8;
+        }
+        while (v) {
+            b++;
+            v >>= 1;
+        }
+        return b;
+    }
+
+private:
+    unsigned long counts[Counters];
+    unsigned int  hist[Histograms][Buckets];
+};
+
+
+// --------------------------------------------------------------------------
+//  Timed outputs
+//
+//  Flashers, one-shot pulses and a failsafe, run on the node so that the
+//  host only has to send state changes.  Each output bit has a mode:
+//
+//      timed.setFlashRate(0, 500);                 // flasher 0: 500ms on, 500ms off
+//      timed.setMode(0, 0x03, cpTimedOutputs::MODE_FLASH);      // OB[0] bits 0,1 flash while on
+//      timed.setMode(0, 0x0C, cpTimedOutputs::MODE_FLASH_ALT);  // bits 2,3 the other way round
+//      timed.setPulseLength(100);
+//      timed.setMode(1, 0xFF, cpTimedOutputs::MODE_PULSE);      // OB[1]: 100ms pulse when turned on
+//      timed.setHoldTimeout(2000);
+//      timed.setMode(0, 0xFF, cpTimedOutputs::MODE_SAFE_OFF);   // OB[0] off if the host goes quiet
+//      cmri.setTimedOutputs(&timed);
+//
+//  unpack() (and any IOXBank) is then given the outputs as they should
+//  be right now rather than OB as the host sent it, and is called again
+//  from proceess() whenever a flasher, pulse or failsafe changes them.
+//  The modes are kept as bit masks over the output bytes, so all of a
+//  byte's bits are worked out at once; pulses are timed in ticks of a
+//  seventh of the pulse length by a 3 bit vertical counter per bit, so a
+//  pulse is at least its length and at most a seventh longer.
+//
+//  The hold timeout runs from the last message the host sent this node;
+//  once it runs out, the failsafe bits go to their safe levels until the
+//  next T message.  Modes and times are in the host's terms: an output
+//  bit that is 1 is on, whatever invertOutputs() says.
+// --------------------------------------------------------------------------
+class cpTimedOutputsBase {
+public:
+    static const byte Flashers = 2;
+    static const byte ModeBuffers = 6;  // flash ... safe, back to back
+
+    enum {                          // Output bit modes
+        MODE_STEADY     = 0,        // follows OB (the default)
+        MODE_FLASH,                 // flashes while on, with flasher 0
+        MODE_FLASH_ALT,             //   ... on while flasher 0 is off
+        MODE_FLASH2,                // flashes while on, with flasher 1
+        MODE_FLASH2_ALT,            //   ... on while flasher 1 is off
+        MODE_PULSE,                 // on for the pulse length when turned on
+        MODE_SAFE_OFF,              // failsafe: off when the hold timeout runs out
+        MODE_SAFE_ON,               // failsafe: on when the hold timeout runs out
+        MODE_NO_SAFE,               // stays as it was when the hold timeout runs out (the default)
+        Modes
+    };
+
+    // Bytes of buffer space needed for a given number of output bytes:
+    // the mode buffers and their staged copy, cmd, running, cnt0/1/2, out
+    static constexpr int storageSize(int maxOB) { return (6 + (2 * ModeBuffers)) * maxOB; }
+
+    void setMode(byte i, byte mask, byte mode);
+    void setFlashRate(byte flasher, unsigned int ms);
+    void setPulseLength(unsigned int ms);
+    void setHoldTimeout(unsigned long ms)       { hold_ms = ms; }
+    bool isFailsafe(void)                       { return failsafe; }
+    byte getMaxOutputBytes(void)                { return maxOB; }
+
+    // Used by cpNodeBase
+    void heard(void)                            { heard_time = millis(); }
+    void beginConfig(void);
+    void configure(int pos, byte c);
+    void applyConfig(void);
+    bool run(const byte *OB, byte *changed, byte len, byte inv, bool command);
+    byte *image(void)                           { return out; }
+
+protected:
+    cpTimedOutputsBase(byte maxOB, byte *storage);
+
+private:
+    void callback_set_Mode(byte *modes, byte i, byte mask, byte mode);
+    void callback_point_Modes(byte *modes);
+
+    byte maxOB;
+    unsigned int flash_ms[Flashers];    // half period of each flasher, 0 = stopped
+    unsigned long flash_time[Flashers]; // millis() of each flasher's next change
+    byte flash_on;                      // bit per flasher: in its on half
+    unsigned int pulse_tick;            // milliseconds per pulse counter tick
+    unsigned long pulse_time;           // millis() of the next tick
+    bool pulsing;                       // some pulse is running
+    unsigned long hold_ms;              // hold timeout, 0 = none
+    unsigned long heard_time;           // millis() of the last message from the host
+    bool failsafe;                      // the hold timeout ran out, no T message since
+    byte cfg_i, cfg_mode;               // Init message mode record being received
+    byte cfg_flash[Flashers];           // Init message settings, applied at its ETX
+    byte cfg_pulse;
+    byte cfg_hold;
+    bool cfg_modes;                     // staged holds the modes, with the records so far
+
+    // Buffers, a byte for each output byte
+    byte *flash;                        // bits that flash
+    byte *flash2;                       //   ... with flasher 1 rather than 0
+    byte *alt;                          //   ... in the opposite phase
+    byte *pulse;                        // bits that pulse
+    byte *hold;                         // failsafe bits
+    byte *safe;                         //   ... and their safe levels
+    byte *staged;                       // The six above, as an Init message is setting them
+    byte *cmd;                          // OB as the host last sent it, without inversion
+    byte *running;                      // pulses running
+    byte *cnt0;                         // Pulse tick counter bit 0 for each lane
+    byte *cnt1;                         // Counter bit 1
+    byte *cnt2;                         // Counter bit 2
+    byte *out;                          // Outputs as they are now, passed to unpack()
+};
+
+// --------------------------------------------------------------------------
+//  Timed outputs for up to MaxOB output bytes, as many as the node has
+// --------------------------------------------------------------------------
+template<byte MaxOB = cpNodeBase::IO_bufsize>
+class cpTimedOutputsSized : public cpTimedOutputsBase {
+    static_assert(MaxOB > 0, "MaxOB must be at least 1");
+public:
+    cpTimedOutputsSized(void) : cpTimedOutputsBase(MaxOB, storage) { }
+
+private:
+    byte storage[cpTimedOutputsBase::storageSize(MaxOB)];
+};
+
+typedef cpTimedOutputsSized<> cpTimedOutputs;
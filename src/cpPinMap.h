@@ -0,0 +1,298 @@
+#pragma once
+
+/*
+    ==================================================================================
+                  cpPinMap              Compile time pin maps for pack() and unpack()
+    ==================================================================================
+
+    This work is licensed under the Creative Commons Attribution-ShareAlike 3.0 Unported License.
+    To view a copy of the license, visit http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    Authors:
+        John Plocher - SPCoast
+
+
+    A pin map lists the 'duino pins behind the 8 bits of one IB or OB byte, bit 0 first:
+
+        typedef cpPinMap::Pins< 2, 3, 4, 5, 6, 7, 8, 9 >           IB0;  // IB[0] bit 0 = D2 ... bit 7 = D9
+        typedef cpPinMap::Pins<12,13,A0,A1,A2,A3, cpPinMap::NC, cpPinMap::NC, true> IB1;  // active low
+
+        IB[0] = IB0::read();
+        OB0::write(OB[0]);
+
+    On the ATmega328P (Pro Mini, Uno) and ATmega32U4 (BBLeo, Leonardo) each pin is
+    resolved to its PORTx/PINx register and bit at compile time, and the pins that
+    share a hardware port are read or written together with a single register access,
+    instead of one digitalRead()/digitalWrite() (with its pin table lookups) per bit.
+    On other processors the same declarations fall back to digitalRead()/digitalWrite().
+
+    NC marks a bit that has no pin: it reads as 0 and is ignored when writing.
+    With Invert set, bits are inverted on the way in and out (active low wiring).
+*/
+
+#include <Arduino.h>
+
+namespace cpPinMap {
+
+    const byte NC = 0xFF;           // Not Connected
+
+    // Hardware ports
+    enum {
+        PORT_NONE = 0,
+        PORT_B    = 2,
+        PORT_C    = 3,
+        PORT_D    = 4,
+        PORT_E    = 5,
+        PORT_F    = 6,
+    };
+
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__) || defined(__AVR_ATmega168__)
+    #define CPPINMAP_DIRECT 1
+    // D0-D7 = PD0-7, D8-D13 = PB0-5, A0-A5 (D14-D19) = PC0-5
+    constexpr byte portOf(byte pin) {
+        return (pin < 8) ? PORT_D : (pin < 14) ? PORT_B : (pin < 20) ? PORT_C : PORT_NONE;
+    }
+    constexpr byte bitOf(byte pin) {
+        return (pin < 8) ? pin : (pin < 14) ? pin - 8 : (pin < 20) ? pin - 14 : 0;
+    }
+#elif defined(__AVR_ATmega32U4__)
+    #define CPPINMAP_DIRECT 1
+    // Leonardo pin numbering, D0-D13, D14-D17 (ISP header), A0-A5 (D18-D23)
+    constexpr byte PIN_PORT[] = {
+        PORT_D, PORT_D, PORT_D, PORT_D, PORT_D, PORT_C, PORT_D, PORT_E,     // D0-D7
+        PORT_B, PORT_B, PORT_B, PORT_B, PORT_D, PORT_C,                     // D8-D13
+        PORT_B, PORT_B, PORT_B, PORT_B,                                     // D14-D17
+        PORT_F, PORT_F, PORT_F, PORT_F, PORT_F, PORT_F,                     // A0-A5
+    };
+    constexpr byte PIN_BIT[] = {
+        2, 3, 1, 0, 4, 6, 7, 6,
+        4, 5, 6, 7, 6, 7,
+        3, 1, 2, 0,
+        7, 6, 5, 4, 1, 0,
+    };
+    constexpr byte portOf(byte pin) {
+        return (pin < sizeof(PIN_PORT)) ? PIN_PORT[pin] : PORT_NONE;
+    }
+    constexpr byte bitOf(byte pin) {
+        return (pin < sizeof(PIN_BIT)) ? PIN_BIT[pin] : 0;
+    }
+#else
+    #define CPPINMAP_DIRECT 0
+    constexpr byte portOf(byte) { return PORT_NONE; }
+    constexpr byte bitOf(byte)  { return 0; }
+#endif
+
+#if CPPINMAP_DIRECT
+    // Register access; with a constant port these compile down to a single IN/OUT
+    static inline volatile byte &pinReg(byte port) {
+        switch (port) {
+#ifdef PINB
+            case PORT_B:  return PINB;
+#endif
+#ifdef PINC
+            case PORT_C:  return PINC;
+#endif
+#ifdef PINE
+            case PORT_E:  return PINE;
+#endif
+#ifdef PINF
+            case PORT_F:  return PINF;
+#endif
+            default:      return PIND;
+        }
+    }
+    static inline volatile byte &portReg(byte port) {
+        switch (port) {
+#ifdef PORTB
+            case PORT_B:  return PORTB;
+#endif
+#ifdef PORTC
+            case PORT_C:  return PORTC;
+#endif
+#ifdef PORTE
+            case PORT_E:  return PORTE;
+#endif
+#ifdef PORTF
+            case PORT_F:  return PORTF;
+#endif
+            default:      return PORTD;
+        }
+    }
+    static inline volatile byte &ddrReg(byte port) {
+        switch (port) {
+#ifdef DDRB
+            case PORT_B:  return DDRB;
+#endif
+#ifdef DDRC
+            case PORT_C:  return DDRC;
+#endif
+#ifdef DDRE
+            case PORT_E:  return DDRE;
+#endif
+#ifdef DDRF
+            case PORT_F:  return DDRF;
+#endif
+            default:      return DDRD;
+        }
+    }
+#endif
+
+    // --------------------------------------------------------------------------
+    //  One IB/OB byte: P0 is the pin for bit 0, ... P7 for bit 7
+    // --------------------------------------------------------------------------
+    template<byte P0,      byte P1 = NC, byte P2 = NC, byte P3 = NC,
+             byte P4 = NC, byte P5 = NC, byte P6 = NC, byte P7 = NC,
+             bool Invert = false>
+    struct Pins {
+
+        // CMRI bit k's pin, if it is on hardware port <port>
+        static constexpr bool on(byte pin, byte port) {
+            return (pin != NC) && (portOf(pin) == port);
+        }
+
+        // Does any bit use hardware port <port>?
+        static constexpr bool uses(byte port) {
+            return on(P0, port) || on(P1, port) || on(P2, port) || on(P3, port) ||
+                   on(P4, port) || on(P5, port) || on(P6, port) || on(P7, port);
+        }
+
+        // Hardware port bits used on <port>
+        static constexpr byte portMask(byte port) {
+            return (on(P0, port) ? (1 << bitOf(P0)) : 0) | (on(P1, port) ? (1 << bitOf(P1)) : 0) |
+                   (on(P2, port) ? (1 << bitOf(P2)) : 0) | (on(P3, port) ? (1 << bitOf(P3)) : 0) |
+                   (on(P4, port) ? (1 << bitOf(P4)) : 0) | (on(P5, port) ? (1 << bitOf(P5)) : 0) |
+                   (on(P6, port) ? (1 << bitOf(P6)) : 0) | (on(P7, port) ? (1 << bitOf(P7)) : 0);
+        }
+
+        // CMRI bits that have a pin
+        static constexpr byte used(void) {
+            return ((P0 != NC) << 0) | ((P1 != NC) << 1) | ((P2 != NC) << 2) | ((P3 != NC) << 3) |
+                   ((P4 != NC) << 4) | ((P5 != NC) << 5) | ((P6 != NC) << 6) | ((P7 != NC) << 7);
+        }
+
+        // Move one pin's bit between its place in the port (v) and CMRI bit k
+        static inline byte gather1(byte pin, byte port, byte v, byte k) {
+            return on(pin, port) ? (((v >> bitOf(pin)) & 1) << k) : 0;
+        }
+        static inline byte scatter1(byte pin, byte port, byte b, byte k) {
+            return on(pin, port) ? (((b >> k) & 1) << bitOf(pin)) : 0;
+        }
+
+        // The CMRI bits found in a snapshot of port <port>
+        static inline byte gather(byte port, byte v) {
+            return gather1(P0, port, v, 0) | gather1(P1, port, v, 1) | gather1(P2, port, v, 2) | gather1(P3, port, v, 3) |
+                   gather1(P4, port, v, 4) | gather1(P5, port, v, 5) | gather1(P6, port, v, 6) | gather1(P7, port, v, 7);
+        }
+
+        // Port <port>'s bits for CMRI byte b
+        static inline byte scatter(byte port, byte b) {
+            return scatter1(P0, port, b, 0) | scatter1(P1, port, b, 1) | scatter1(P2, port, b, 2) | scatter1(P3, port, b, 3) |
+                   scatter1(P4, port, b, 4) | scatter1(P5, port, b, 5) | scatter1(P6, port, b, 6) | scatter1(P7, port, b, 7);
+        }
+
+#if CPPINMAP_DIRECT
+        static inline byte readPort(byte port) {
+            return uses(port) ? gather(port, pinReg(port)) : 0;
+        }
+
+        static inline void writePort(byte port, byte b) {
+            if (uses(port)) {
+                volatile byte &r = portReg(port);
+                r = (r & ~portMask(port)) | scatter(port, b);
+            }
+        }
+
+        static inline void modePort(byte port, bool output, bool pullup) {
+            if (uses(port)) {
+                if (output) {
+                    ddrReg(port) |= portMask(port);
+                } else {
+                    ddrReg(port) &= ~portMask(port);
+                    if (pullup) portReg(port) |=  portMask(port);
+                    else        portReg(port) &= ~portMask(port);
+                }
+            }
+        }
+
+        // Read the whole byte: one register read per hardware port used
+        static inline byte read(void) {
+            byte b = readPort(PORT_B) | readPort(PORT_C) | readPort(PORT_D) |
+                     readPort(PORT_E) | readPort(PORT_F);
+            return Invert ? (byte)(~b & used()) : b;
+        }
+
+        // Write the whole byte: one read-modify-write per hardware port used
+        static inline void write(byte b) {
+            if (Invert) {
+                b = ~b;
+            }
+            byte sreg = SREG;
+            cli();                      // in case an interrupt handler touches the same port
+            writePort(PORT_B, b);
+            writePort(PORT_C, b);
+            writePort(PORT_D, b);
+            writePort(PORT_E, b);
+            writePort(PORT_F, b);
+            SREG = sreg;
+        }
+
+        static inline void setInputs(bool pullup = true) {
+            modePort(PORT_B, false, pullup);
+            modePort(PORT_C, false, pullup);
+            modePort(PORT_D, false, pullup);
+            modePort(PORT_E, false, pullup);
+            modePort(PORT_F, false, pullup);
+        }
+
+        static inline void setOutputs(void) {
+            modePort(PORT_B, true, false);
+            modePort(PORT_C, true, false);
+            modePort(PORT_D, true, false);
+            modePort(PORT_E, true, false);
+            modePort(PORT_F, true, false);
+        }
+#else
+        // Portable fallback, one digitalRead()/digitalWrite() per bit
+        static inline byte read(void) {
+            const byte pins[8] = { P0, P1, P2, P3, P4, P5, P6, P7 };
+            byte b = 0;
+            for (byte k = 0; k < 8; k++) {
+                if (pins[k] != NC) {
+                    b |= (digitalRead(pins[k]) ? 1 : 0) << k;
+                }
+            }
+            return Invert ? (byte)(~b & used()) : b;
+        }
+
+        static inline void write(byte b) {
+            const byte pins[8] = { P0, P1, P2, P3, P4, P5, P6, P7 };
+            if (Invert) {
+                b = ~b;
+            }
+            for (byte k = 0; k < 8; k++) {
+                if (pins[k] != NC) {
+                    digitalWrite(pins[k], (b >> k) & 0x01);
+                }
+            }
+        }
+
+        static inline void setInputs(bool pullup = true) {
+            const byte pins[8] = { P0, P1, P2, P3, P4, P5, P6, P7 };
+            for (byte k = 0; k < 8; k++) {
+                if (pins[k] != NC) {
+                    pinMode(pins[k], pullup ? INPUT_PULLUP : INPUT);
+                }
+            }
+        }
+
+        static inline void setOutputs(void) {
+            const byte pins[8] = { P0, P1, P2, P3, P4, P5, P6, P7 };
+            for (byte k = 0; k < 8; k++) {
+                if (pins[k] != NC) {
+                    pinMode(pins[k], OUTPUT);
+                }
+            }
+        }
+#endif
+    };
+}
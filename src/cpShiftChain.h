@@ -0,0 +1,101 @@
+#pragma once
+
+/*
+    ==================================================================================
+                  cpShiftChain          74HC595 / 74HC165 shift register chains over SPI
+    ==================================================================================
+
+    This work is licensed under the Creative Commons Attribution-ShareAlike 3.0 Unported License.
+    To view a copy of the license, visit http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    Authors:
+        John Plocher - SPCoast
+
+
+    A faster expander than the MCP23017s behind IOX: a chain of 74HC595s for
+    outputs and a chain of 74HC165s for inputs, on the hardware SPI pins, each
+    moved as a whole in one burst at SPI clock rates instead of an I2C
+    transaction per port at 100 or 400 kHz.
+
+        cpShiftChain<10, 9> chain;              // 595 latch (RCLK) on D10, 165 load (SH/LD) on D9
+        chain.begin(4000000);                   // in setup(): SPI at 4 MHz
+        ...
+        void pack(byte *IB, int len) {
+            IB[0] = ...;                        // onboard bytes as before
+            chain.read(&IB[2], len - 2);        // then the 165s
+        }
+        void unpack(byte *OB, int len) {
+            ...
+            chain.write(&OB[2], len - 2);       // the 595s
+        }
+
+    Wiring: SCK to every chip's clock (595 SRCLK, 165 CLK), MOSI to the first
+    595's SER and each 595's QH' to the next one's SER, the first 165's QH to
+    MISO and each 165's SER from the next one's QH (the last one's SER and
+    every CLK INH to ground).  Byte 0 of either chain is the chip nearest the
+    'duino; bit 0 is its QA output or A input.
+
+    write() shifts every byte out and only then raises the 595s' latch, so all
+    the outputs change together on that one edge and never show a half
+    written image.  read() pulses the 165s' load low first, so every input is
+    sampled at the same instant before any of them is shifted in.  Both can
+    share SCK and MOSI: shifting one chain only clocks junk into the other's
+    shift register, not its outputs.  The 165's QH is always driven, so if
+    another SPI device shares MISO, the chain needs a tri-state buffer there.
+
+    The latch and load pins go through cpPinMap, a single register write each
+    on the ATmega328P and 32U4.  Leave LoadPin out (cpPinMap::NC) for an
+    output-only chain, or make LatchPin cpPinMap::NC for an input-only one.
+    On a 328P, D10 (SS) makes a good latch pin, as SPI.begin() needs it to be
+    an output anyway.
+*/
+
+#include <Arduino.h>
+#include <SPI.h>
+#include "cpPinMap.h"
+
+template<byte LatchPin, byte LoadPin = cpPinMap::NC>
+class cpShiftChain {
+    typedef cpPinMap::Pins<LatchPin> Latch;
+    typedef cpPinMap::Pins<LoadPin>  Load;
+
+public:
+    // clock: SPI clock in Hz, the fastest the wiring between the chips can take
+    void begin(unsigned long clock = 4000000) {
+        settings = SPISettings(clock, MSBFIRST, SPI_MODE0);
+        Latch::write(1);                // both idle high, set before they become
+        Latch::setOutputs();            // outputs so they don't glitch low
+        Load::write(1);
+        Load::setOutputs();
+        SPI.begin();
+    }
+
+    // Shift <len> bytes out to the 595s, farthest chip first, then latch them all at once
+    void write(const byte *OB, byte len) {
+        byte i;
+
+        SPI.beginTransaction(settings);
+        Latch::write(0);
+        for (i = len; i > 0; i--) {
+            SPI.transfer(OB[i - 1]);
+        }
+        Latch::write(1);                // every output changes on this edge
+        SPI.endTransaction();
+    }
+
+    // Sample every 165 input at once, then shift <len> bytes in, nearest chip first
+    void read(byte *IB, byte len) {
+        byte i;
+
+        Load::write(0);                 // the 165s copy their inputs while low
+        SPI.beginTransaction(settings);
+        Load::write(1);
+        for (i = 0; i < len; i++) {
+            IB[i] = SPI.transfer(0);
+        }
+        SPI.endTransaction();
+    }
+
+private:
+    SPISettings settings;
+};